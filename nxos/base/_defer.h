@@ -0,0 +1,32 @@
+/** @file _defer.h
+ *  @brief Deferred work internal interface.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE__DEFER_H__
+#define __NXOS_BASE__DEFER_H__
+
+#include "base/defer.h"
+
+/** @addtogroup kernelinternal */
+/*@{*/
+
+/** @defgroup deferinternal Deferred work */
+/*@{*/
+
+/** Run the deferred work from the low priority system timer interrupt,
+ * unless an application kernel installed its own handler.
+ */
+void nx__defer_irq(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE__DEFER_H__ */
@@ -0,0 +1,39 @@
+/** @file _timer.h
+ *  @brief Software timers internal interface.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE__TIMER_H__
+#define __NXOS_BASE__TIMER_H__
+
+#include "base/timer.h"
+
+/** @addtogroup kernelinternal */
+/*@{*/
+
+/** @defgroup timerinternal Software timers */
+/*@{*/
+
+/** Check if any software timer is running.
+ *
+ * @return TRUE if the low priority system timer interrupt should be
+ * triggered on every tick, to run the timers.
+ */
+bool nx__timer_running(void);
+
+/** Run the timers that expired, from the low priority system timer
+ * interrupt.
+ */
+void nx__timer_irq(void);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE__TIMER_H__ */
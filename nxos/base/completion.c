@@ -0,0 +1,69 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/interrupts.h"
+#include "base/drivers/systick.h"
+
+#include "base/completion.h"
+
+/* The handlers installed by the application kernel, if any. */
+static volatile nx_completion_block_t completion_block = NULL;
+static volatile nx_completion_can_block_t completion_can_block = NULL;
+static volatile nx_closure_t completion_notify = NULL;
+
+void nx_completion_init(nx_completion_t *c) {
+  c->done = FALSE;
+}
+
+void nx_completion_signal(nx_completion_t *c) {
+  nx_closure_t notify = completion_notify;
+
+  c->done = TRUE;
+  if (notify)
+    notify();
+}
+
+bool nx_completion_wait(nx_completion_t *c, U32 timeout) {
+  U32 deadline = nx_systick_get_ms() + timeout;
+
+  while (!c->done) {
+    nx_completion_block_t block = completion_block;
+    U32 remaining = NX_COMPLETION_WAIT_FOREVER;
+
+    if (timeout != NX_COMPLETION_WAIT_FOREVER) {
+      U32 now = nx_systick_get_ms();
+
+      if (now >= deadline)
+        return FALSE;
+      remaining = deadline - now;
+    }
+
+    /* Without a block handler, just poll the completion. */
+    if (block)
+      block(c, remaining);
+  }
+
+  return TRUE;
+}
+
+bool nx_completion_can_block(void) {
+  nx_completion_can_block_t can_block = completion_can_block;
+
+  return can_block != NULL && can_block();
+}
+
+void nx_completion_install_handlers(nx_completion_block_t block,
+                                    nx_completion_can_block_t can_block,
+                                    nx_closure_t notify) {
+  nx_interrupts_disable();
+  completion_block = block;
+  completion_can_block = can_block;
+  completion_notify = notify;
+  nx_interrupts_enable();
+}
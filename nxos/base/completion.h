@@ -0,0 +1,126 @@
+/** @file completion.h
+ *  @brief Completion of asynchronous operations.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_COMPLETION_H__
+#define __NXOS_BASE_COMPLETION_H__
+
+#include "base/types.h"
+
+/** @addtogroup kernel */
+/*@{*/
+
+/** @defgroup completion Completions
+ *
+ * A completion lets code wait for the end of an operation carried out
+ * by an interrupt handler, such as a bus transaction or a data
+ * transfer. The driver resets the completion when it starts the
+ * operation, and signals it from its interrupt handler when the
+ * operation ends.
+ *
+ * Without an application kernel, waiting for a completion simply
+ * spins until it is signalled. Application kernels with a scheduler
+ * can install handlers with nx_completion_install_handlers(), to block
+ * the waiting task instead and give the CPU to other tasks in the
+ * meantime.
+ */
+/*@{*/
+
+/** Timeout value to wait for a completion indefinitely. */
+#define NX_COMPLETION_WAIT_FOREVER 0xFFFFFFFF
+
+/** A completion. */
+typedef struct {
+  volatile bool done; /**< TRUE once the completion has been signalled. */
+} nx_completion_t;
+
+/** A completion block handler.
+ *
+ * The handler is called by nx_completion_wait() when the completion
+ * has not been signalled yet. If it can, it should block the caller
+ * until the completion is signalled, or at most @a timeout
+ * milliseconds. Spurious wakeups are allowed. If the caller cannot be
+ * blocked, for instance because it is an interrupt handler, the
+ * handler should return immediately, and the completion is polled.
+ *
+ * @param c The completion to wait for.
+ * @param timeout The maximum time to block, in milliseconds, or
+ * NX_COMPLETION_WAIT_FOREVER.
+ */
+typedef void (*nx_completion_block_t)(nx_completion_t *c, U32 timeout);
+
+/** A completion block check handler.
+ *
+ * @return TRUE if the block handler would block the caller, FALSE if
+ * it would return immediately.
+ */
+typedef bool (*nx_completion_can_block_t)(void);
+
+/** Reset @a c to the pending state.
+ *
+ * @param c The completion to reset.
+ *
+ * @note A driver should reset the completion before starting the
+ * operation, so that a quick interrupt handler cannot signal it before
+ * the reset.
+ */
+void nx_completion_init(nx_completion_t *c);
+
+/** Signal @a c, and wake up its waiters.
+ *
+ * This function never blocks, and can be called from any interrupt
+ * handler, or from normal code.
+ *
+ * @param c The completion to signal.
+ */
+void nx_completion_signal(nx_completion_t *c);
+
+/** Wait for @a c to be signalled.
+ *
+ * @param c The completion to wait for.
+ * @param timeout The maximum time to wait, in milliseconds, or
+ * NX_COMPLETION_WAIT_FOREVER.
+ * @return TRUE if @a c was signalled, FALSE on timeout.
+ *
+ * @note The completion is not consumed: it stays signalled until it
+ * is reset with nx_completion_init().
+ */
+bool nx_completion_wait(nx_completion_t *c, U32 timeout);
+
+/** Check whether nx_completion_wait() can block the caller.
+ *
+ * When it cannot, for instance in an interrupt handler, with
+ * interrupts disabled, or without an application kernel, waiting only
+ * spins on the completion. A driver whose interrupt handler could not
+ * run meanwhile should then poll its hardware instead.
+ *
+ * @return TRUE if the caller would be blocked while waiting.
+ */
+bool nx_completion_can_block(void);
+
+/** Install handlers to block on completions.
+ *
+ * @param block The handler called to block on a pending completion, or
+ * NULL to spin again.
+ * @param can_block The handler that tells whether @a block can block
+ * the caller, or NULL if it never can.
+ * @param notify The handler called every time a completion is
+ * signalled, possibly from interrupt context, or NULL. It should wake
+ * up the waiters blocked by @a block.
+ */
+void nx_completion_install_handlers(nx_completion_block_t block,
+                                    nx_completion_can_block_t can_block,
+                                    nx_closure_t notify);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_COMPLETION_H__ */
@@ -0,0 +1,96 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/interrupts.h"
+#include "base/drivers/_systick.h"
+
+#include "base/_defer.h"
+
+#define DEFER_RING_MASK (NX_DEFER_RING_SIZE - 1)
+
+/* The work ring. Producers reserve slots at the head, and the single
+ * consumer runs them from the tail. The indexes run freely, and are
+ * masked when accessing the ring.
+ *
+ * As the ARM7 has no compare-and-swap instruction, slot reservation
+ * masks interrupts for a couple of instructions. Filling in a slot is
+ * done with interrupts enabled, and the ready flag tells the consumer
+ * when the slot is complete.
+ */
+static struct {
+  struct {
+    nx_defer_func_t func;
+    U32 arg;
+    volatile bool ready;
+  } items[NX_DEFER_RING_SIZE];
+
+  volatile U32 head; /* The next slot to reserve. */
+  volatile U32 tail; /* The next slot to run. */
+} ring;
+
+/* The handler installed by the application kernel, if any. */
+static volatile nx_closure_t defer_handler = NULL;
+
+bool nx_defer(nx_defer_func_t func, U32 arg) {
+  U32 slot;
+
+  nx_interrupts_disable();
+  if (ring.head - ring.tail == NX_DEFER_RING_SIZE) {
+    nx_interrupts_enable();
+    return FALSE;
+  }
+  slot = ring.head++ & DEFER_RING_MASK;
+  nx_interrupts_enable();
+
+  ring.items[slot].func = func;
+  ring.items[slot].arg = arg;
+  ring.items[slot].ready = TRUE;
+
+  if (defer_handler)
+    defer_handler();
+  else
+    nx__systick_trigger_sysirq();
+
+  return TRUE;
+}
+
+void nx_defer_run(void) {
+  while (ring.tail != ring.head) {
+    U32 slot = ring.tail & DEFER_RING_MASK;
+    nx_defer_func_t func;
+    U32 arg;
+
+    /* If the producer of this slot was interrupted before it finished
+     * filling it, stop here. It will notify us again once done.
+     */
+    if (!ring.items[slot].ready)
+      break;
+
+    func = ring.items[slot].func;
+    arg = ring.items[slot].arg;
+    ring.items[slot].ready = FALSE;
+    ring.tail++;
+
+    func(arg);
+  }
+}
+
+bool nx_defer_pending(void) {
+  return (ring.tail != ring.head &&
+          ring.items[ring.tail & DEFER_RING_MASK].ready);
+}
+
+void nx_defer_install_handler(nx_closure_t handler) {
+  defer_handler = handler;
+}
+
+void nx__defer_irq(void) {
+  if (defer_handler == NULL)
+    nx_defer_run();
+}
@@ -0,0 +1,91 @@
+/** @file defer.h
+ *  @brief Deferred work from interrupt handlers.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_DEFER_H__
+#define __NXOS_BASE_DEFER_H__
+
+#include "base/types.h"
+
+/** @addtogroup kernel */
+/*@{*/
+
+/** @defgroup defer Deferred work
+ *
+ * Interrupt handlers should do as little as possible, to keep the
+ * interrupt latency of the system low. The deferred work facility lets
+ * them queue a function call (a "bottom half") for later execution,
+ * outside of their own interrupt context.
+ *
+ * Work items are kept in a fixed size ring, so queueing never
+ * allocates memory. By default, the queued work runs in the low
+ * priority system timer interrupt, which is triggered as soon as work
+ * is queued. Application kernels with a scheduler can instead install
+ * a handler with nx_defer_install_handler(), and run the work in a
+ * task of their own.
+ */
+/*@{*/
+
+/** The number of work items that can be pending at any time. */
+#define NX_DEFER_RING_SIZE 32
+
+/** A deferred work function, called with the argument given at
+ * queueing time.
+ */
+typedef void (*nx_defer_func_t)(U32 arg);
+
+/** Queue a call to @a func with @a arg for later execution.
+ *
+ * This function never blocks, and can be called from any interrupt
+ * handler, or from normal code.
+ *
+ * @param func The function to call.
+ * @param arg The argument to pass to @a func.
+ * @return TRUE if the work was queued, FALSE if the ring was full.
+ */
+bool nx_defer(nx_defer_func_t func, U32 arg);
+
+/** Run all the pending deferred work.
+ *
+ * Work items are run in the order in which they were queued.
+ *
+ * @note Only one execution context may run deferred work. Unless a
+ * handler was installed with nx_defer_install_handler(), this is the
+ * low priority system timer interrupt.
+ */
+void nx_defer_run(void);
+
+/** Check if deferred work is ready to run.
+ *
+ * @return TRUE if nx_defer_run() would run at least one work item.
+ *
+ * @note A work item whose queueing was interrupted before completion
+ * is not ready yet. Its producer notifies the handler again once done.
+ */
+bool nx_defer_pending(void);
+
+/** Install @a handler to take over the execution of deferred work.
+ *
+ * The handler is called every time work is queued, possibly from
+ * interrupt context. It should arrange for nx_defer_run() to be
+ * called soon, for instance by waking up a dedicated task.
+ *
+ * @param handler The handler to install, or NULL to let the system
+ * timer run the deferred work again.
+ *
+ * @note The handler runs in the context of the caller of nx_defer().
+ */
+void nx_defer_install_handler(nx_closure_t handler);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_DEFER_H__ */
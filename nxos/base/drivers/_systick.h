@@ -24,6 +24,14 @@
 /** Initialize the system timer driver. */
 void nx__systick_init(void);
 
+/** Trigger the low priority system interrupt.
+ *
+ * Unlike nx_systick_call_scheduler(), the interrupt is triggered even
+ * if no scheduler callback is installed. It is used to run deferred
+ * work.
+ */
+void nx__systick_trigger_sysirq(void);
+
 /*@}*/
 /*@}*/
 
@@ -12,6 +12,7 @@
 #include "base/nxt.h"
 #include "base/assert.h"
 #include "base/interrupts.h"
+#include "base/completion.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/systick.h"
 
@@ -47,9 +48,22 @@ static volatile struct {
   NULL, 0, {0}, 0
 };
 
+/* Signalled by the interrupt handler when both transmit buffers of the
+ * DMA controller are empty.
+ */
+static nx_completion_t uart_tx_done;
+
 static void uart_isr(void) {
   U32 status = *AT91C_US1_CSR;
 
+  /* The transmit buffer empty condition lasts as long as nothing is
+   * sent, so it is only enabled while a writer waits for it.
+   */
+  if ((status & AT91C_US_TXBUFE) && (*AT91C_US1_IMR & AT91C_US_TXBUFE)) {
+    *AT91C_US1_IDR = AT91C_US_TXBUFE;
+    nx_completion_signal(&uart_tx_done);
+  }
+
   /* If we receive a break condition from the Bluecore, send up a NULL
    * packet and reset the controller status.
    */
@@ -169,7 +183,21 @@ void nx__uart_write(const U8 *data, U32 lng) {
   NX_ASSERT(data != NULL);
   NX_ASSERT(lng > 0);
 
-  while (*AT91C_US1_TNCR != 0);
+  /* Wait for the next transmit buffer to be free. The controller can
+   * only interrupt when both buffers are free, which costs the
+   * overlap of the transfers, so this is only worth it if the caller
+   * can block meanwhile. Otherwise, and in contexts where the
+   * interrupt handler may not run, poll the buffer.
+   */
+  if (nx_completion_can_block()) {
+    while (*AT91C_US1_TNCR != 0) {
+      nx_completion_init(&uart_tx_done);
+      *AT91C_US1_IER = AT91C_US_TXBUFE;
+      nx_completion_wait(&uart_tx_done, NX_COMPLETION_WAIT_FOREVER);
+    }
+  } else {
+    while (*AT91C_US1_TNCR != 0);
+  }
 
   *AT91C_US1_TNPR = (U32)data;
   *AT91C_US1_TNCR = lng;
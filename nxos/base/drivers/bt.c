@@ -11,6 +11,8 @@
 #include "base/types.h"
 #include "base/util.h"
 #include "base/display.h"
+#include "base/defer.h"
+#include "base/completion.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/_uart.h"
 
@@ -19,6 +21,11 @@
 #define BT_ACK_TIMEOUT 3000
 #define BT_ARGS_BUFSIZE (BT_NAME_MAX_LNG+1)
 
+/* Number of received packets that can wait for parsing. Must be a
+ * power of 2.
+ */
+#define BT_RX_SLOTS 4
+
 /* to remove : */
 /*#define UART_DEBUG*/
 #ifdef UART_DEBUG
@@ -226,6 +233,25 @@ static volatile struct {
 
 } bt_state;
 
+/* Signalled every time a message from the Bluecore has been parsed. */
+static nx_completion_t bt_msg_received;
+
+
+/* The packets received by the UART interrupt handler, waiting to be
+ * parsed by bt_parse_packet() as deferred work. The interrupt handler
+ * is the only one to move the head, and the parser the only one to
+ * move the tail, so no locking is needed.
+ */
+static struct {
+  struct {
+    U8 data[UART_BUFSIZE];
+    U32 len;
+  } slots[BT_RX_SLOTS];
+
+  volatile U32 head;
+  volatile U32 tail;
+} bt_rx;
+
 
 
 
@@ -280,11 +306,24 @@ static bool bt_check_checksum(U8 *msg, U32 len) {
 
 static bool bt_wait_msg(U8 msg)
 {
-  U32 start = nx_systick_get_ms();
+  U32 deadline = nx_systick_get_ms() + BT_ACK_TIMEOUT;
+  U32 now;
+
+  while (1) {
+    /* Reset the completion before checking, so that a message parsed
+     * in between is not missed.
+     */
+    nx_completion_init(&bt_msg_received);
 
-  while(bt_state.last_msg != msg && start+BT_ACK_TIMEOUT > nx_systick_get_ms());
+    if (bt_state.last_msg == msg)
+      return TRUE;
+
+    now = nx_systick_get_ms();
+    if (now >= deadline)
+      return FALSE;
 
-  return bt_state.last_msg == msg;
+    nx_completion_wait(&bt_msg_received, deadline - now);
+  }
 }
 
 
@@ -297,18 +336,12 @@ static void bt_reseted(void)
 
 
 
-static void bt_uart_command_callback(U8 *msg, U32 len)
+static void bt_handle_packet(U8 *msg, U32 len)
 {
   U32 i;
 
-  /* if it's a break from the nxt */
-  if (msg == NULL || len == 0) {
-    bt_state.nmb_checksum_errors++;
-    return;
-  }
-
   /* we check first the checksum and ignore the message if the checksum is invalid */
-  if (len < 1 || !bt_check_checksum(msg, len)) {
+  if (!bt_check_checksum(msg, len)) {
     bt_state.nmb_checksum_errors++;
     return;
   }
@@ -331,6 +364,8 @@ static void bt_uart_command_callback(U8 *msg, U32 len)
     bt_state.args[i] = 0;
   }
 
+  nx_completion_signal(&bt_msg_received);
+
 
   if (msg[0] == BT_MSG_HEARTBEAT) {
     bt_state.last_heartbeat = nx_systick_get_ms();
@@ -432,9 +467,52 @@ static void bt_uart_command_callback(U8 *msg, U32 len)
 }
 
 
+/* Deferred work: parse a packet queued by the interrupt handler, and
+ * give its slot back.
+ */
+static void bt_parse_packet(U32 slot)
+{
+  bt_handle_packet(bt_rx.slots[slot].data, bt_rx.slots[slot].len);
+  bt_rx.tail++;
+}
+
+
+/* Called by the UART interrupt handler. Only queue the packet here,
+ * the parsing is deferred out of interrupt context.
+ */
+static void bt_uart_command_callback(U8 *msg, U32 len)
+{
+  U32 slot;
+
+  /* if it's a break from the nxt, or if the packet is too short to
+   * hold a message and its checksum */
+  if (msg == NULL || len < 3 || len > UART_BUFSIZE) {
+    bt_state.nmb_checksum_errors++;
+    return;
+  }
+
+  /* if the parser is lagging behind, the packet is dropped */
+  if (bt_rx.head - bt_rx.tail == BT_RX_SLOTS) {
+    bt_state.nmb_checksum_errors++;
+    return;
+  }
+
+  slot = bt_rx.head & (BT_RX_SLOTS - 1);
+  memcpy(bt_rx.slots[slot].data, msg, len);
+  bt_rx.slots[slot].len = len;
+  bt_rx.head++;
+
+  if (!nx_defer(bt_parse_packet, slot)) {
+    bt_rx.head--;
+    bt_state.nmb_checksum_errors++;
+  }
+}
+
+
 void nx_bt_init(void)
 {
   memset((void*)&bt_state, 0, sizeof(bt_state));
+  bt_rx.head = bt_rx.tail = 0;
   USB_SEND("nx_bt_init()");
 
   bt_state.new_handle = -1;
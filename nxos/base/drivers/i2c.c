@@ -12,6 +12,7 @@
 #include "base/interrupts.h"
 #include "base/util.h"
 #include "base/display.h"
+#include "base/completion.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/_sensors.h"
 #include "base/drivers/i2c.h"
@@ -115,6 +116,11 @@ static volatile struct i2c_port {
 
 } i2c_state[NXT_N_SENSORS];
 
+/* Transaction completions, signalled by the interrupt handler when the
+ * bus of a port goes back to idle after a transaction.
+ */
+static nx_completion_t i2c_done[NXT_N_SENSORS];
+
 /* Forward declarations. */
 static void i2c_isr(void);
 static void i2c_log(const char *s);
@@ -204,6 +210,9 @@ void nx_i2c_register(U32 sensor, U8 address, bool lego_compat) {
   //  I2C_MAX_TXN*sizeof(struct i2c_txn_info));
   i2c_state[sensor].current_txn = 0;
   i2c_state[sensor].n_txns = 0;
+
+  /* There is no transaction to wait for. */
+  nx_completion_signal(&i2c_done[sensor]);
 }
 
 /** Unregister the device on the given sensor port. */
@@ -295,6 +304,7 @@ i2c_txn_err nx_i2c_start_transaction(U32 sensor, i2c_txn_mode mode,
     return I2C_ERR_DATA;
 
   i2c_state[sensor].bus_state = I2C_CONFIG;
+  nx_completion_init(&i2c_done[sensor]);
 
   t = i2c_state[sensor].txns;
   i2c_state[sensor].current_txn = 0;
@@ -373,6 +383,14 @@ bool nx_i2c_busy(U32 sensor)
     || i2c_state[sensor].current_txn < i2c_state[sensor].n_txns;
 }
 
+void nx_i2c_wait(U32 sensor)
+{
+  if (sensor >= NXT_N_SENSORS)
+    return;
+
+  nx_completion_wait(&i2c_done[sensor], NX_COMPLETION_WAIT_FOREVER);
+}
+
 /** Sets the I2C bus state for the given sensor to the provided state.
  *
  * This function takes into account the lego_compat parameter of the given
@@ -733,6 +751,13 @@ static void i2c_isr(void) {
         break;
       }
 
+    /* Once the bus is back to idle after the last sub transaction,
+     * the whole transaction is over.
+     */
+    if (p->bus_state == I2C_IDLE && p->current_txn == p->n_txns
+        && !i2c_done[sensor].done)
+      nx_completion_signal(&i2c_done[sensor]);
+
     /** Update CODR and SODR to reflect changes for this sensor's
      * pins. */
     if (codr)
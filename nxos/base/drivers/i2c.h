@@ -153,6 +153,19 @@ i2c_txn_status nx_i2c_get_txn_status(U32 sensor);
  */
 bool nx_i2c_busy(U32 sensor);
 
+/** Wait for the end of the I2C transaction on port @a sensor.
+ *
+ * Once this function returns, nx_i2c_busy() is FALSE and the result of
+ * the transaction can be retrieved with nx_i2c_get_txn_status().
+ *
+ * @param sensor The sensor port number.
+ *
+ * @note The wait is done on a completion signalled by the I2C
+ * interrupt handler. If a scheduler installed completion handlers, the
+ * calling task is blocked for the duration of the transaction.
+ */
+void nx_i2c_wait(U32 sensor);
+
 /*@}*/
 /*@}*/
 
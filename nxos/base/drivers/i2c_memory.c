@@ -12,14 +12,10 @@
 #include "base/nxt.h"
 #include "base/display.h"
 #include "base/drivers/sensors.h"
-#include "base/drivers/systick.h"
 #include "base/drivers/i2c.h"
 
 #include "base/drivers/i2c_memory.h"
 
-/** Active waiting time before I2C transactions, in milliseconds. */
-#define NX_I2C_TXN_WAIT 10
-
 /** Initializes a remote memory unit of address 'address' on the given
  * sensor port.
  *
@@ -54,8 +50,7 @@ i2c_txn_err nx_i2c_memory_read(U32 sensor, U8 internal_address,
   if (err != I2C_ERR_OK)
     return err;
 
-  while (nx_i2c_busy(sensor))
-    nx_systick_wait_ms(NX_I2C_TXN_WAIT);
+  nx_i2c_wait(sensor);
 
   return nx_i2c_get_txn_status(sensor);
 }
@@ -75,8 +70,7 @@ i2c_txn_err nx_i2c_memory_write(U32 sensor, U8 internal_address,
   if (err != I2C_ERR_OK)
     return err;
 
-  while (nx_i2c_busy(sensor))
-    nx_systick_wait_ms(NX_I2C_TXN_WAIT);
+  nx_i2c_wait(sensor);
 
   return nx_i2c_get_txn_status(sensor);
 }
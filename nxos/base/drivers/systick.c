@@ -11,6 +11,9 @@
 #include "base/nxt.h"
 #include "base/types.h"
 #include "base/interrupts.h"
+#include "base/_defer.h"
+#include "base/_timer.h"
+#include "base/completion.h"
 #include "base/drivers/aic.h"
 #include "base/drivers/_avr.h"
 #include "base/drivers/_lcd.h"
@@ -25,6 +28,11 @@
 /* We want a timer interrupt 1000 times per second. */
 #define SYSIRQ_FREQ 1000
 
+/* The PIT counts 3000 times per millisecond, so its current value
+ * gives the time within the millisecond to a third of a microsecond.
+ */
+#define PIT_TICKS_PER_US (PIT_BASE_FREQUENCY / 1000000)
+
 /* The system IRQ processing takes place in two different interrupt
  * handlers: the main PIT interrupt handler runs at a high priority,
  * keeps the system time accurate, and triggers the lower priority
@@ -57,16 +65,31 @@ static nx_closure_t scheduler_cb = NULL;
  */
 static bool scheduler_inhibit = FALSE;
 
+/* Set when the scheduler callback is to be invoked by the low priority
+ * handler. The handler also runs for deferred work and timers, which
+ * must not call a masked scheduler.
+ */
+static volatile bool scheduler_pending = FALSE;
+
 /* Low priority handler, called 1000 times a second by the high
- * priority handler if a scheduler callback is registered.
+ * priority handler if a scheduler callback is registered or timers are
+ * running, and whenever interrupt handlers defer some work.
  */
 static void systick_sched(void) {
   /* Acknowledge the interrupt. */
   nx_aic_clear(SCHEDULER_SYSIRQ);
 
+  /* Run the work deferred by interrupt handlers. */
+  nx__defer_irq();
+
+  /* Run the software timers. */
+  nx__timer_irq();
+
   /* Call into the scheduler. */
-  if (scheduler_cb)
+  if (scheduler_pending && scheduler_cb) {
+    scheduler_pending = FALSE;
     scheduler_cb();
+  }
 }
 
 /* High priority handler, called 1000 times a second */
@@ -77,8 +100,11 @@ static void systick_isr(void) {
    */
   status = *AT91C_PITC_PIVR;
 
-  /* Do the system timekeeping. */
-  systick_time++;
+  /* Do the system timekeeping. If the interrupt was held up for more
+   * than a period, the PIT counted all the periods that went by, and
+   * nx_systick_get_us() already added them to the time.
+   */
+  systick_time += (status & AT91C_PITC_PICNT) >> 20;
 
   /* Keeping up with the AVR link is a crucial task in the system, and
    * must absolutely be kept up with at all costs. Thus, handling it
@@ -96,6 +122,9 @@ static void systick_isr(void) {
 
   if (!scheduler_inhibit)
     nx_systick_call_scheduler();
+
+  if (nx__timer_running())
+    nx__systick_trigger_sysirq();
 }
 
 void nx__systick_init(void) {
@@ -123,10 +152,43 @@ U32 nx_systick_get_ms(void) {
   return systick_time;
 }
 
+U32 nx_systick_get_us(void) {
+  U32 ms, piir;
+
+  /* If the system timer ticks between the two reads, the PIT count
+   * may be from the next millisecond, so read them again.
+   */
+  do {
+    ms = systick_time;
+    piir = *AT91C_PITC_PIIR;
+  } while (ms != systick_time);
+
+  /* The PIT also counts the periods that elapsed since the last tick
+   * was handled, should its interrupt be held up. These are not in the
+   * system time yet.
+   */
+  ms += (piir & AT91C_PITC_PICNT) >> 20;
+
+  return ms * 1000 + (piir & AT91C_PITC_CPIV) / PIT_TICKS_PER_US;
+}
+
 void nx_systick_wait_ms(U32 ms) {
-  U32 final = systick_time + ms;
+  /* Wait for a completion that never comes, so that a scheduler can
+   * block the caller for the duration of the sleep.
+   */
+  nx_completion_t never;
+
+  nx_completion_init(&never);
+  nx_completion_wait(&never, ms);
+}
+
+void nx_systick_wait_us(U32 us) {
+  U32 start = nx_systick_get_us();
 
-  while (systick_time < final);
+  /* The start time is rounded down, so wait one more microsecond to
+   * be sure to wait at least @a us.
+   */
+  while (nx_systick_get_us() - start <= us);
 }
 
 void nx_systick_wait_ns(U32 ns) {
@@ -145,8 +207,10 @@ void nx_systick_call_scheduler(void) {
   /* If the application kernel set a scheduling callback, trigger the
    * lower priority IRQ in which the scheduler runs.
    */
-  if (scheduler_cb)
+  if (scheduler_cb) {
+    scheduler_pending = TRUE;
     nx_aic_set(SCHEDULER_SYSIRQ);
+  }
 }
 
 void nx_systick_mask_scheduler(void) {
@@ -156,3 +220,7 @@ void nx_systick_mask_scheduler(void) {
 void nx_systick_unmask_scheduler(void) {
   scheduler_inhibit = FALSE;
 }
+
+void nx__systick_trigger_sysirq(void) {
+  nx_aic_set(SCHEDULER_SYSIRQ);
+}
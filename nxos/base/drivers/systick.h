@@ -30,22 +30,54 @@
 /** Return the number of milliseconds elapsed since bootup. */
 U32 nx_systick_get_ms(void);
 
+/** Return the number of microseconds elapsed since bootup.
+ *
+ * The time within the current millisecond is read from the system
+ * timer's hardware counter, so this is consistent with
+ * nx_systick_get_ms(), and never goes backwards.
+ *
+ * @return The time since bootup, in microseconds.
+ *
+ * @note The time wraps around every 71 minutes or so. Differences
+ * between two times are still right, as long as they are shorter than
+ * that.
+ *
+ * @note This may be called from interrupt handlers and with interrupts
+ * disabled. The clock keeps running for up to 4 seconds without the
+ * system timer interrupt being handled.
+ */
+U32 nx_systick_get_us(void);
+
 /** Sleep for @a ms milliseconds.
  *
  * @param ms The number of milliseconds to sleep.
  *
  * @note As the Baseplate provides no scheduler, this sleeping is a busy
- * wait loop.
+ * wait loop, unless an application kernel installed completion
+ * handlers (see nx_completion_install_handlers()).
  */
 void nx_systick_wait_ms(U32 ms);
 
+/** Busy wait for @a us microseconds.
+ *
+ * @param us The number of microseconds to wait.
+ *
+ * @note The wait is timed with nx_systick_get_us(), and lasts between
+ * @a us and @a us + 1 microseconds, plus the time spent in interrupt
+ * handlers at the end of the wait. Unlike nx_systick_wait_ms(), it
+ * never lets a scheduler run other tasks, so it is meant for short
+ * waits. It may be used with interrupts disabled, for up to 4 seconds.
+ */
+void nx_systick_wait_us(U32 us);
+
 /** Sleep for approximately @a ns nanoseconds.
  *
  * @param ns The number of nanoseconds to sleep.
  *
  * @note This sleep routine is a busy loop whose accuracy is based
  * entirely on the instruction timings and pipeline delays in the ARM7
- * cpu. It may not be exact.
+ * cpu. It may not be exact. For waits of a microsecond or more, use
+ * nx_systick_wait_us().
  */
 void nx_systick_wait_ns(U32 ns);
 
@@ -60,7 +92,9 @@ void nx_systick_wait_ns(U32 ns);
  *
  * @note The callback does not have to implement a scheduler. It's just
  * that implementing a scheduler is the most common reason to want such
- * a periodic callback.
+ * a periodic callback. Code that only needs to run periodically should
+ * rather use a software timer (see nx_timer_start()), so that the
+ * callback stays free for an actual scheduler.
  */
 void nx_systick_install_scheduler(nx_closure_t scheduler_cb);
 
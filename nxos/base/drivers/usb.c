@@ -11,6 +11,7 @@
 #include "base/types.h"
 #include "base/interrupts.h"
 #include "base/assert.h"
+#include "base/completion.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/aic.h"
 #include "base/util.h"
@@ -243,6 +244,11 @@ static volatile struct {
   U8 current_rx_bank;
 } usb_state;
 
+/* Signalled by the interrupt handler when the device becomes ready to
+ * send data again.
+ */
+static nx_completion_t usb_ready;
+
 
 /* The flags in the UDP_CSR register are a little strange: writing to
  * them does not instantly change their value. Their value will change
@@ -278,6 +284,7 @@ static void usb_write_data(int endpoint, const U8 *ptr, U32 length) {
   tx = endpoint / 2;
 
   /* The bus is now busy. */
+  nx_completion_init(&usb_ready);
   usb_state.status = USB_BUSY;
 
   if (endpoint == 0)
@@ -534,6 +541,7 @@ static U32 usb_manage_setup_packet(void) {
     while (AT91C_UDP_CSR[3] != 0);
 
     usb_state.status = USB_READY;
+    nx_completion_signal(&usb_ready);
     break;
 
   case USB_BREQUEST_GET_INTERFACE: /* TODO: This should respond, not stall. */
@@ -620,6 +628,7 @@ static void usb_isr(void) {
     *AT91C_UDP_ICR = AT91C_UDP_RXRSM;
     isr &= ~AT91C_UDP_RXRSM;
     usb_state.status = usb_state.pre_suspend_status;
+    nx_completion_signal(&usb_ready);
   }
 
 
@@ -681,6 +690,7 @@ static void usb_isr(void) {
       } else {
         /* then it means that we sent all the data and the host has acknowledged it */
         usb_state.status = USB_READY;
+        nx_completion_signal(&usb_ready);
       }
       return;
     }
@@ -771,7 +781,8 @@ void nx_usb_write(U8 *data, U32 length) {
   NX_ASSERT(length > 0);
 
   /* TODO: Make call asynchronous */
-  while (usb_state.status != USB_READY);
+  while (usb_state.status != USB_READY)
+    nx_completion_wait(&usb_ready, NX_COMPLETION_WAIT_FOREVER);
 
   /* start sending the data */
   usb_write_data(2, data, length);
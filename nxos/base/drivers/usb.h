@@ -54,7 +54,9 @@ bool nx_usb_can_write(void);
 /** Send @a length bytes of @a data to the USB host.
  *
  * If there is already data buffered, this function may block. Use
- * nx_usb_can_send() to check for buffered data.
+ * nx_usb_can_send() to check for buffered data. If a scheduler installed
+ * completion handlers, the calling task is blocked until the previous
+ * transfer ends.
  *
  * @param data The data to send.
  * @param length The amount of data to send.
@@ -0,0 +1,78 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+
+#include "base/lib/memalloc/memalloc.h"
+#include "base/lib/memalloc/arena.h"
+
+#define WORD_MASK (sizeof(void*) - 1)
+#define ROUNDUP_WORD(size) (((size) + WORD_MASK) & ~WORD_MASK)
+
+/* The arena descriptor sits at the start of its buffer. Positions in
+ * the arena are offsets from the start of the buffer, past the
+ * descriptor.
+ */
+struct nx_arena {
+  U32 pos; /* The offset of the next allocation. */
+  U32 size; /* The size of the buffer. */
+};
+
+#define ARENA_START(arena) ((U8*)(arena) + ROUNDUP_WORD(sizeof(nx_arena_t)))
+
+nx_arena_t *nx_arena_init(U32 size) {
+  nx_arena_t *arena;
+
+  NX_ASSERT_MSG(size <= (U32)-1 - 2 * ROUNDUP_WORD(sizeof(*arena)),
+                "Arena too large");
+  size = ROUNDUP_WORD(size);
+  arena = nx_malloc(ROUNDUP_WORD(sizeof(*arena)) + size);
+  arena->pos = 0;
+  arena->size = size;
+
+  return arena;
+}
+
+void *nx_arena_alloc(nx_arena_t *arena, U32 size) {
+  void *ptr;
+
+  /* Check the size before rounding it up, which could wrap around. The
+   * space left is a multiple of the word size, so the rounded size fits
+   * as well.
+   */
+  if (size > arena->size - arena->pos)
+    return NULL;
+  size = ROUNDUP_WORD(size);
+
+  ptr = ARENA_START(arena) + arena->pos;
+  arena->pos += size;
+
+  return ptr;
+}
+
+nx_arena_mark_t nx_arena_mark(nx_arena_t *arena) {
+  return arena->pos;
+}
+
+void nx_arena_rewind(nx_arena_t *arena, nx_arena_mark_t mark) {
+  NX_ASSERT(mark <= arena->pos);
+  arena->pos = mark;
+}
+
+void nx_arena_reset(nx_arena_t *arena) {
+  arena->pos = 0;
+}
+
+U32 nx_arena_available(nx_arena_t *arena) {
+  return arena->size - arena->pos;
+}
+
+void nx_arena_destroy(nx_arena_t *arena) {
+  nx_free(arena);
+}
@@ -0,0 +1,97 @@
+/** @file arena.h
+ *  @brief Arena allocator.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_MEMALLOC_ARENA_H__
+#define __NXOS_BASE_MEMALLOC_ARENA_H__
+
+#include "base/types.h"
+
+/** @addtogroup lib */
+/*@{*/
+
+/** @defgroup arena Arena allocator
+ *
+ * An arena serves allocations from a buffer taken from the memory
+ * allocator, by simply moving a pointer forward. Allocations have no
+ * header and cannot be freed individually: they are all released at
+ * once, by resetting the arena or rewinding it to a mark.
+ *
+ * This suits work that makes many short-lived allocations which all die
+ * together, such as parsing a command or computing a path.
+ *
+ * @note Like the memory allocator, arenas are @b not safe for
+ * concurrent access.
+ */
+/*@{*/
+
+typedef struct nx_arena nx_arena_t;
+
+/** A position in an arena, see nx_arena_mark(). */
+typedef U32 nx_arena_mark_t;
+
+/** Create an arena of @a size bytes.
+ *
+ * The memory for the arena is taken from the memory allocator at once.
+ *
+ * @param size The number of bytes the arena can serve.
+ * @return The new arena.
+ */
+nx_arena_t *nx_arena_init(U32 size);
+
+/** Allocate @a size bytes from @a arena.
+ *
+ * @param arena The arena to allocate from.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the allocated memory, aligned on a machine
+ * word, or NULL if @a arena does not have @a size bytes left.
+ */
+void *nx_arena_alloc(nx_arena_t *arena, U32 size);
+
+/** Return the current position of @a arena.
+ *
+ * @param arena The arena to query.
+ * @return A mark, to give to nx_arena_rewind().
+ */
+nx_arena_mark_t nx_arena_mark(nx_arena_t *arena);
+
+/** Release all the allocations made from @a arena since @a mark was
+ * taken.
+ *
+ * @param arena The arena to rewind.
+ * @param mark A mark returned by nx_arena_mark() on @a arena, which
+ * must not have been rewound past it since.
+ */
+void nx_arena_rewind(nx_arena_t *arena, nx_arena_mark_t mark);
+
+/** Release all the allocations made from @a arena.
+ *
+ * @param arena The arena to reset.
+ */
+void nx_arena_reset(nx_arena_t *arena);
+
+/** Return the number of bytes left in @a arena.
+ *
+ * @param arena The arena to query.
+ * @return The number of bytes that can still be allocated.
+ */
+U32 nx_arena_available(nx_arena_t *arena);
+
+/** Destroy @a arena, and give its memory back to the memory allocator.
+ *
+ * @param arena The arena to destroy.
+ */
+void nx_arena_destroy(nx_arena_t *arena);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_MEMALLOC_ARENA_H__ */
@@ -0,0 +1,861 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+/* Allocator benchmark and fuzzer for the host build of memalloc.
+ *
+ *   bench replay [-p pool size] [-i interval] <trace>
+ *
+ * replays an allocation trace, as recorded on the brick by an
+ * nx_memalloc_set_trace_hook() hook and saved by read_usb_dump.py's
+ * memtrace mode. It reports the cost of each kind of operation in
+ * cycles (mean, 99th percentile and worst case), and the state of the
+ * heap every @c interval operations, to follow fragmentation over
+ * time. Blocks are 8 bytes larger here than on the brick, because of
+ * the 64 bit pointers in the block headers, and relocatable blocks are
+ * replayed as plain blocks that the compactor leaves alone, so the pool
+ * may need to be larger than on the brick for the trace to fit.
+ *
+ *   bench fuzz [-p pool size] [-n ops] [-s seed] [-w trace]
+ *
+ * runs random allocations, resizes and frees, of plain and relocatable
+ * blocks, with compactions in between, and checks each of them against
+ * a reference allocator, the host libc. Some blocks come from memory
+ * pools carved out of the main one, which nx_free() and nx_realloc()
+ * must find again, from an object pool, or from an arena that is
+ * rewound as its blocks go away. Blocks must lie within the pool, be
+ * aligned, never overlap, and keep their contents, locked blocks must
+ * not move, and the allocator statistics and nx_memalloc_check() must
+ * agree. When built with memalloc_guards=1,
+ * blocks are also overrun on purpose, which the check must catch. The
+ * operations can be saved as a trace, to be replayed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include "base/types.h"
+#include "base/lib/memalloc/memalloc.h"
+#include "base/lib/memalloc/pool.h"
+#include "base/lib/memalloc/arena.h"
+
+/*
+ * Host port of the parts of the baseplate that memalloc uses.
+ */
+
+U8 __ram_userspace_start__;
+U8 __ram_userspace_end__;
+
+/* Where the assertion with the message @c assert_caught jumps to, if
+ * the caller expects it. By default, that is running out of memory.
+ */
+static jmp_buf *assert_handler = NULL;
+static const char *assert_caught = "Out of memory";
+
+void nx_assert_error(const char *file, const int line,
+                     const char *expr, const char *msg) {
+  if (assert_handler != NULL && strcmp(msg, assert_caught) == 0)
+    longjmp(*assert_handler, 1);
+
+  printf("ASSERT %s:%d: %s %s\n", file, line, expr, msg);
+  exit(1);
+}
+
+void nx_usb_write(U8 *data __attribute__((unused)),
+                  U32 length __attribute__((unused))) {
+}
+
+bool nx_usb_data_written(void) {
+  return TRUE;
+}
+
+/*
+ * Helpers.
+ */
+
+#define DEFAULT_POOL_SIZE (64 * 1024)
+
+static U8 *pool;
+static U32 pool_size = DEFAULT_POOL_SIZE;
+
+static void pool_init(void) {
+  pool = malloc(pool_size);
+  if (pool == NULL) {
+    printf("Cannot allocate a pool of %lu bytes\n", pool_size);
+    exit(1);
+  }
+  nx_memalloc_init_full(pool, pool_size);
+}
+
+static inline unsigned long long cycles(void) {
+#if defined(__i386__) || defined(__x86_64__)
+  return __builtin_ia32_rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* A trace record, as stored by the trace hook. */
+struct record {
+  uint32_t op;
+  uint32_t ptr;
+  uint32_t size;
+  uint32_t old;
+};
+
+static void print_heap_header(void) {
+  printf("%10s %8s %8s %8s %8s %6s\n", "ops", "used", "free", "largest",
+         "blocks", "frag");
+}
+
+static void print_heap(U32 ops) {
+  nx_memalloc_stats_t stats;
+
+  nx_memalloc_get_stats(&stats);
+  printf("%10lu %8lu %8lu %8lu %8lu %5.1f%%\n", ops, stats.used, stats.free,
+         stats.largest_free, stats.free_blocks,
+         stats.free ? 100.0 * (1 - (double)stats.largest_free / stats.free)
+                    : 0.0);
+}
+
+/*
+ * Replay.
+ */
+
+/* The blocks of the trace, mapping trace addresses to host blocks. Open
+ * addressing with linear probing, and backward shift on removal.
+ */
+static struct {
+  uint32_t key;
+  void *block;
+} *map;
+static U32 map_mask;
+
+static U32 map_slot(uint32_t key) {
+  U32 i = (key * 2654435761U) & map_mask;
+
+  while (map[i].block != NULL && map[i].key != key)
+    i = (i + 1) & map_mask;
+  return i;
+}
+
+static void map_put(uint32_t key, void *block) {
+  U32 i = map_slot(key);
+  map[i].key = key;
+  map[i].block = block;
+}
+
+static void *map_take(uint32_t key) {
+  U32 i = map_slot(key), j, home;
+  void *block = map[i].block;
+
+  if (block == NULL)
+    return NULL;
+
+  map[i].block = NULL;
+  for (j = (i + 1) & map_mask; map[j].block != NULL; j = (j + 1) & map_mask) {
+    home = (map[j].key * 2654435761U) & map_mask;
+    if (((j - home) & map_mask) >= ((j - i) & map_mask)) {
+      map[i] = map[j];
+      map[j].block = NULL;
+      i = j;
+    }
+  }
+  return block;
+}
+
+/* The cost of one kind of operation. */
+struct cost {
+  const char *name;
+  unsigned long long *samples;
+  U32 count;
+  U32 failed;
+};
+
+static void cost_add(struct cost *cost, unsigned long long sample) {
+  cost->samples[cost->count++] = sample;
+}
+
+static int cmp_samples(const void *a, const void *b) {
+  unsigned long long x = *(const unsigned long long *)a;
+  unsigned long long y = *(const unsigned long long *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void cost_print(struct cost *cost) {
+  unsigned long long total = 0;
+  U32 i;
+
+  if (cost->count == 0) {
+    printf("%-8s %10d\n", cost->name, 0);
+    return;
+  }
+
+  qsort(cost->samples, cost->count, sizeof(*cost->samples), cmp_samples);
+  for (i = 0; i < cost->count; i++)
+    total += cost->samples[i];
+
+  printf("%-8s %10lu %10.1f %10llu %10llu %10lu\n", cost->name, cost->count,
+         (double)total / cost->count,
+         cost->samples[cost->count * 99 / 100],
+         cost->samples[cost->count - 1], cost->failed);
+}
+
+/* Resize @a old to @a size bytes, and set @a cost to the cycles it
+ * took. Return NULL if the pool is out of memory.
+ */
+static void *try_realloc(void *old, U32 size, unsigned long long *cost) {
+  jmp_buf handler;
+  unsigned long long start;
+  void *block;
+
+  assert_handler = &handler;
+  if (setjmp(handler)) {
+    assert_handler = NULL;
+    return NULL;
+  }
+  start = cycles();
+  block = nx_realloc(old, size);
+  *cost = cycles() - start;
+  assert_handler = NULL;
+
+  return block;
+}
+
+static int replay(const char *path, U32 interval) {
+  struct cost costs[3] = {
+    { "alloc", NULL, 0, 0 },
+    { "realloc", NULL, 0, 0 },
+    { "free", NULL, 0, 0 },
+  };
+  struct record *trace, *r;
+  unsigned long long start, end;
+  U32 count, i, unknown = 0;
+  void *block, *old;
+  long length;
+  FILE *f;
+
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  count = length / sizeof(*trace);
+  trace = malloc(count * sizeof(*trace) + 1);
+  if (fread(trace, sizeof(*trace), count, f) != count) {
+    perror(path);
+    return 1;
+  }
+  fclose(f);
+
+  for (i = 0; i < 3; i++)
+    costs[i].samples = malloc(count * sizeof(*costs[i].samples) + 1);
+  for (map_mask = 1; map_mask < 2 * count; map_mask <<= 1);
+  map = calloc(map_mask, sizeof(*map));
+  map_mask--;
+
+  pool_init();
+  if (interval == 0)
+    interval = count / 20 ? count / 20 : 1;
+
+  printf("Replaying %lu operations in a pool of %lu bytes\n\n", count,
+         pool_size);
+  print_heap_header();
+  print_heap(0);
+
+  for (i = 0; i < count; i++) {
+    r = &trace[i];
+
+    switch (r->op) {
+    case NX_MEMALLOC_OP_ALLOC:
+      start = cycles();
+      block = nx_malloc_from(NULL, r->size);
+      end = cycles();
+      if (block == NULL) {
+        costs[r->op].failed++;
+        break;
+      }
+      cost_add(&costs[r->op], end - start);
+      map_put(r->ptr, block);
+      break;
+
+    case NX_MEMALLOC_OP_REALLOC:
+      old = map_take(r->old);
+      if (old == NULL)
+        unknown++;
+      block = try_realloc(old, r->size, &end);
+      if (block == NULL) {
+        /* A failed resize leaves the block as it was. */
+        costs[r->op].failed++;
+        if (old != NULL)
+          map_put(r->old, old);
+        break;
+      }
+      cost_add(&costs[r->op], end);
+      map_put(r->ptr, block);
+      break;
+
+    case NX_MEMALLOC_OP_FREE:
+      block = map_take(r->ptr);
+      if (block == NULL) {
+        unknown++;
+        break;
+      }
+      start = cycles();
+      nx_free(block);
+      end = cycles();
+      cost_add(&costs[r->op], end - start);
+      break;
+
+    case NX_MEMALLOC_OP_MOVE:
+      /* Relocatable blocks are replayed as plain blocks, which the
+       * compactor does not move.
+       */
+      block = map_take(r->old);
+      if (block != NULL)
+        map_put(r->ptr, block);
+      break;
+
+    default:
+      printf("Bad operation %u in record %lu\n", r->op, i);
+      return 1;
+    }
+
+    if ((i + 1) % interval == 0 || i + 1 == count)
+      print_heap(i + 1);
+  }
+
+  printf("\n%-8s %10s %10s %10s %10s %10s\n", "cycles", "count", "mean",
+         "p99", "worst", "failed");
+  for (i = 0; i < 3; i++)
+    cost_print(&costs[i]);
+  if (unknown)
+    printf("\n%lu operations on blocks that failed to allocate\n", unknown);
+
+  for (i = 0; i < 3; i++)
+    free(costs[i].samples);
+  free(map);
+  free(trace);
+
+  return 0;
+}
+
+/*
+ * Fuzzing.
+ */
+
+#define MAX_LIVE 512
+#define MAX_HANDLES 64
+
+#define MEMPOOLS 2
+#define MEMPOOL_SIZE (12 * 1024) /* Half of it is TLSF's on the host. */
+#define POOL_OBJ_SIZE 40
+#define POOL_OBJS 32
+#define ARENA_SIZE (2 * 1024)
+
+/* Where a block comes from, besides the main pool. */
+enum source {
+  FROM_HEAP,
+  FROM_MEMPOOL,
+  FROM_POOL,
+  FROM_ARENA,
+};
+
+static struct {
+  U8 *block;
+  U8 *ref; /* The reference copy, from the host libc. */
+  U32 size;
+  bool aligned;
+  nx_handle_t handle; /* For relocatable blocks. */
+  bool locked;
+  enum source source;
+  U32 mempool; /* For blocks of memory pools. */
+  nx_arena_mark_t mark; /* For arena blocks, the arena before them. */
+} live[MAX_LIVE];
+static U32 live_count, handle_count;
+
+static nx_mempool_t *mempools[MEMPOOLS];
+static U32 mempool_count[MEMPOOLS];
+static nx_pool_t *obj_pool;
+static U32 obj_count;
+static nx_arena_t *arena;
+static U32 arena_count;
+
+static uint32_t rand_state;
+
+/* A xorshift generator, so that a seed gives the same run everywhere. */
+static U32 rand_next(void) {
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+static U32 rand_size(void) {
+  U32 r = rand_next() % 100;
+
+  if (r < 70)
+    return 1 + rand_next() % 64;
+  else if (r < 95)
+    return 65 + rand_next() % 960;
+  else
+    return 1025 + rand_next() % 7168;
+}
+
+static FILE *trace_file;
+
+static void trace_hook(nx_memalloc_op_t op, void *ptr, U32 size, void *old) {
+  struct record r = { op, (uintptr_t)ptr, size, (uintptr_t)old };
+  fwrite(&r, sizeof(r), 1, trace_file);
+}
+
+static U32 fuzz_op;
+
+#define CHECK(expr, ...) do {                       \
+    if (!(expr)) {                                  \
+      printf("FAIL at operation %lu: ", fuzz_op);   \
+      printf(__VA_ARGS__);                          \
+      printf("\n");                                 \
+      exit(1);                                      \
+    }                                               \
+  } while (0)
+
+/* Update the address of block @a i, if it is relocatable. */
+static void refresh(U32 i) {
+  if (live[i].handle && !live[i].locked) {
+    live[i].block = nx_hlock(live[i].handle);
+    nx_hunlock(live[i].handle);
+  }
+}
+
+static void fill(U32 i, U32 from) {
+  U32 j;
+
+  refresh(i);
+  for (j = from; j < live[i].size; j++)
+    live[i].block[j] = live[i].ref[j] = rand_next();
+}
+
+static void check_contents(U32 i) {
+  refresh(i);
+  CHECK(memcmp(live[i].block, live[i].ref, live[i].size) == 0,
+        "block %p of %lu bytes corrupted", live[i].block, live[i].size);
+}
+
+static void check_placement(U32 i) {
+  U8 *b;
+  U32 j;
+
+  refresh(i);
+  b = live[i].block;
+  CHECK(b >= pool && b + live[i].size <= pool + pool_size,
+        "block %p out of the pool", b);
+  if (live[i].source == FROM_POOL || live[i].source == FROM_ARENA)
+    CHECK(((uintptr_t)b & (sizeof(void*) - 1)) == 0,
+          "block %p misaligned", b);
+  else if (!live[i].aligned)
+    CHECK(((uintptr_t)b & (2 * sizeof(void*) - 1)) == 0,
+          "block %p misaligned", b);
+
+  for (j = 0; j < live_count; j++) {
+    refresh(j);
+    if (j != i)
+      CHECK(b + live[i].size <= live[j].block ||
+            live[j].block + live[j].size <= b,
+            "block %p overlaps block %p", b, live[j].block);
+  }
+}
+
+static void check_pool_stats(nx_mempool_t *mempool, U32 blocks) {
+  nx_memalloc_stats_t stats;
+
+  nx_mempool_get_stats(mempool, &stats);
+  CHECK(stats.allocs - stats.frees == blocks,
+        "%lu allocs and %lu frees for %lu blocks", stats.allocs,
+        stats.frees, blocks);
+  CHECK(stats.used + stats.free <= stats.pool_size,
+        "%lu used and %lu free in a pool of %lu", stats.used, stats.free,
+        stats.pool_size);
+  CHECK(stats.used <= stats.peak_used, "used above its peak");
+  CHECK(stats.largest_free <= stats.free, "largest free block above total");
+  CHECK((stats.free_blocks == 0) == (stats.free == 0),
+        "%lu bytes in %lu free blocks", stats.free, stats.free_blocks);
+}
+
+static void check_stats(void) {
+  U32 blocks = live_count - obj_count - arena_count, i;
+
+  for (i = 0; i < MEMPOOLS; i++) {
+    check_pool_stats(mempools[i], mempool_count[i]);
+    blocks -= mempool_count[i];
+  }
+
+  /* The handle table, the memory pools, the object pool and the arena
+   * are blocks of their own.
+   */
+  check_pool_stats(NULL, blocks + 1 + MEMPOOLS + 2);
+  CHECK(nx_pool_available(obj_pool) == POOL_OBJS - obj_count,
+        "%lu objects available with %lu in use",
+        nx_pool_available(obj_pool), obj_count);
+}
+
+static void fuzz_alloc(U32 *ooms) {
+  U32 i = live_count, size = rand_size(), kind = rand_next() % 20, j;
+  jmp_buf handler;
+
+  assert_handler = &handler;
+  if (setjmp(handler)) {
+    assert_handler = NULL;
+    (*ooms)++;
+    return;
+  }
+
+  live[i].aligned = FALSE;
+  live[i].handle = 0;
+  live[i].source = FROM_HEAP;
+  if (kind >= 16) {
+    /* The other allocators fail by returning NULL. */
+    assert_handler = NULL;
+    if (kind < 18) {
+      live[i].mempool = rand_next() % MEMPOOLS;
+      live[i].block = nx_malloc_from(mempools[live[i].mempool], size);
+      live[i].source = FROM_MEMPOOL;
+    } else if (kind == 18) {
+      size = POOL_OBJ_SIZE;
+      live[i].block = nx_pool_alloc(obj_pool);
+      live[i].source = FROM_POOL;
+    } else {
+      live[i].mark = nx_arena_mark(arena);
+      live[i].block = nx_arena_alloc(arena, size);
+      live[i].source = FROM_ARENA;
+    }
+    if (live[i].block == NULL) {
+      (*ooms)++;
+      return;
+    }
+    if (live[i].source == FROM_MEMPOOL)
+      mempool_count[live[i].mempool]++;
+    else if (live[i].source == FROM_POOL)
+      obj_count++;
+    else
+      arena_count++;
+  } else if (kind < 4 && handle_count < MAX_HANDLES) {
+    live[i].handle = nx_halloc(size);
+    live[i].block = nx_hlock(live[i].handle);
+    live[i].locked = TRUE;
+    handle_count++;
+  } else if (kind == 4) {
+    live[i].block = nx_malloc_aligned(size, 4 << (rand_next() % 8));
+    live[i].aligned = TRUE;
+  } else if (kind < 7) {
+    live[i].block = nx_calloc(1, size);
+    for (j = 0; j < size; j++)
+      CHECK(live[i].block[j] == 0, "calloc block %p not zeroed",
+            live[i].block);
+  } else {
+    live[i].block = nx_malloc(size);
+  }
+  assert_handler = NULL;
+
+  live[i].size = size;
+  live[i].ref = malloc(size);
+  live_count++;
+  check_placement(i);
+  fill(i, 0);
+}
+
+/* Give arena block @a i back, by rewinding the arena to it if it is the
+ * last one, or once all the arena blocks are gone.
+ */
+static void arena_free(U32 i) {
+  U32 j;
+
+  arena_count--;
+  if (arena_count == 0) {
+    nx_arena_reset(arena);
+    CHECK(nx_arena_available(arena) == ARENA_SIZE,
+          "%lu bytes left in an empty arena", nx_arena_available(arena));
+    return;
+  }
+
+  for (j = 0; j < live_count; j++) {
+    if (live[j].source == FROM_ARENA && live[j].mark > live[i].mark)
+      return;
+  }
+  nx_arena_rewind(arena, live[i].mark);
+}
+
+static void fuzz_free(U32 i) {
+  check_contents(i);
+  if (live[i].source == FROM_POOL) {
+    nx_pool_free(obj_pool, live[i].block);
+    obj_count--;
+  } else if (live[i].source == FROM_ARENA) {
+    arena_free(i);
+  } else if (live[i].handle) {
+    if (live[i].locked)
+      nx_hunlock(live[i].handle);
+    nx_hfree(live[i].handle);
+    handle_count--;
+  } else if (live[i].aligned)
+    nx_free_aligned(live[i].block);
+  else if (rand_next() % 32 == 0)
+    CHECK(nx_realloc(live[i].block, 0) == NULL, "realloc to 0 bytes");
+  else
+    nx_free(live[i].block);
+  if (live[i].source == FROM_MEMPOOL)
+    mempool_count[live[i].mempool]--;
+  free(live[i].ref);
+  live[i] = live[--live_count];
+}
+
+static void fuzz_realloc(U32 i, U32 *ooms) {
+  U32 size = rand_size(), old_size = live[i].size;
+  jmp_buf handler;
+  U8 *block;
+
+  if (live[i].aligned || live[i].source == FROM_POOL ||
+      live[i].source == FROM_ARENA)
+    return;
+
+  if (live[i].handle && live[i].locked) {
+    nx_hunlock(live[i].handle);
+    live[i].locked = FALSE;
+  }
+
+  assert_handler = &handler;
+  if (setjmp(handler)) {
+    assert_handler = NULL;
+    (*ooms)++;
+    check_contents(i);
+    return;
+  }
+  if (live[i].handle) {
+    nx_hrealloc(live[i].handle, size);
+    block = nx_hlock(live[i].handle);
+    nx_hunlock(live[i].handle);
+  } else {
+    block = nx_realloc(live[i].block, size);
+  }
+  assert_handler = NULL;
+
+  /* Blocks of memory pools are left alone when their pool is full. */
+  if (block == NULL) {
+    CHECK(live[i].source == FROM_MEMPOOL, "realloc of block %p failed",
+          live[i].block);
+    (*ooms)++;
+    check_contents(i);
+    return;
+  }
+
+  live[i].block = block;
+  live[i].size = size < old_size ? size : old_size;
+  check_contents(i);
+  live[i].size = size;
+  live[i].ref = realloc(live[i].ref, size);
+  check_placement(i);
+  if (size > old_size)
+    fill(i, old_size);
+}
+
+#ifdef NX_MEMALLOC_GUARDS
+/* Overwrite the byte after the plain block @a i, and check that
+ * nx_memalloc_check() catches it.
+ */
+static void fuzz_overrun(U32 i) {
+  U8 *guard = live[i].block + live[i].size, saved = *guard;
+  jmp_buf handler;
+
+  *guard ^= 0xff;
+  assert_handler = &handler;
+  assert_caught = "Heap overrun";
+  if (!setjmp(handler)) {
+    nx_memalloc_check();
+    CHECK(FALSE, "overrun of block %p not caught", live[i].block);
+  }
+  assert_handler = NULL;
+  assert_caught = "Out of memory";
+  *guard = saved;
+}
+#endif
+
+/* Compact the heap by a random amount, checking that locked blocks stay
+ * put, and then lock and unlock relocatable blocks at random.
+ */
+static void fuzz_compact(void) {
+  U32 i;
+
+  nx_memalloc_compact(rand_next() % 4 ? rand_next() % 4096 + 1 : 0);
+
+  for (i = 0; i < live_count; i++) {
+    if (!live[i].handle)
+      continue;
+
+    if (live[i].locked) {
+      CHECK(nx_hlock(live[i].handle) == live[i].block,
+            "locked block %p moved", live[i].block);
+      nx_hunlock(live[i].handle);
+    }
+    if (rand_next() % 2) {
+      if (live[i].locked)
+        nx_hunlock(live[i].handle);
+      else
+        live[i].block = nx_hlock(live[i].handle);
+      live[i].locked = !live[i].locked;
+    }
+  }
+}
+
+static int fuzz(U32 seed, U32 ops, const char *trace_path) {
+  nx_memalloc_stats_t stats;
+  U32 ooms = 0, used, free_blocks, i, r;
+  U32 empty_used, mempool_used[MEMPOOLS];
+
+  if (trace_path != NULL) {
+    trace_file = fopen(trace_path, "wb");
+    if (trace_file == NULL) {
+      perror(trace_path);
+      return 1;
+    }
+  }
+
+  pool_init();
+
+  /* Grow the handle table to its largest size right away, so that it
+   * does not leave holes behind as it grows.
+   */
+  for (i = 0; i < MAX_HANDLES; i++)
+    live[i].handle = nx_halloc(1);
+  for (i = 0; i < MAX_HANDLES; i++)
+    nx_hfree(live[i].handle);
+  empty_used = nx_memalloc_used();
+
+  for (i = 0; i < MEMPOOLS; i++) {
+    mempools[i] = nx_mempool_create(MEMPOOL_SIZE);
+    CHECK(mempools[i] != NULL, "memory pool too small");
+    mempool_used[i] = nx_mempool_used(mempools[i]);
+  }
+  obj_pool = nx_pool_create(POOL_OBJ_SIZE, POOL_OBJS);
+  arena = nx_arena_init(ARENA_SIZE);
+  nx_memalloc_get_stats(&stats);
+  used = stats.used;
+  free_blocks = stats.free_blocks;
+
+  if (trace_file != NULL)
+    nx_memalloc_set_trace_hook(trace_hook);
+
+  rand_state = seed ? seed : 1;
+  printf("Fuzzing %lu operations with seed %lu in a pool of %lu bytes\n",
+         ops, seed, pool_size);
+
+  for (fuzz_op = 0; fuzz_op < ops; fuzz_op++) {
+    r = rand_next() % 100;
+    if (live_count == 0 || (r < 45 && live_count < MAX_LIVE))
+      fuzz_alloc(&ooms);
+    else if (r < 65)
+      fuzz_realloc(rand_next() % live_count, &ooms);
+    else
+      fuzz_free(rand_next() % live_count);
+
+    if (fuzz_op % 64 == 0)
+      fuzz_compact();
+    if (fuzz_op % 256 == 0) {
+      for (i = 0; i < live_count; i++)
+        check_contents(i);
+      check_stats();
+      CHECK(nx_memalloc_check(), "heap check skipped");
+#ifdef NX_MEMALLOC_GUARDS
+      i = live_count > 0 ? rand_next() % live_count : 0;
+      if (i < live_count && !live[i].handle && !live[i].aligned &&
+          live[i].source != FROM_POOL && live[i].source != FROM_ARENA)
+        fuzz_overrun(i);
+#endif
+    }
+  }
+
+  while (live_count > 0)
+    fuzz_free(live_count - 1);
+  check_stats();
+
+  nx_memalloc_get_stats(&stats);
+  CHECK(nx_memalloc_used() == used, "%lu bytes leaked",
+        nx_memalloc_used() - used);
+  CHECK(stats.free_blocks == free_blocks,
+        "%lu free blocks left in an empty pool", stats.free_blocks);
+  for (i = 0; i < MEMPOOLS; i++)
+    CHECK(nx_mempool_used(mempools[i]) == mempool_used[i],
+          "%lu bytes leaked in memory pool %lu",
+          nx_mempool_used(mempools[i]) - mempool_used[i], i);
+
+  for (i = 0; i < MEMPOOLS; i++)
+    nx_mempool_destroy(mempools[i]);
+  nx_pool_destroy(obj_pool);
+  nx_arena_destroy(arena);
+  CHECK(nx_memalloc_used() == empty_used, "%lu bytes leaked by the pools",
+        nx_memalloc_used() - empty_used);
+
+  if (trace_file != NULL) {
+    nx_memalloc_set_trace_hook(NULL);
+    fclose(trace_file);
+  }
+
+  printf("%lu allocations, %lu out of memory, peak use %lu bytes\n",
+         stats.allocs, ooms, stats.peak_used);
+  printf("PASS\n");
+  return 0;
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s replay [-p pool size] [-i interval] <trace>\n"
+         "       %s fuzz [-p pool size] [-n ops] [-s seed] [-w trace]\n",
+         name, name);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  U32 interval = 0, ops = 1000000, seed = time(NULL);
+  const char *trace_path = NULL;
+  int i;
+
+  if (argc < 2)
+    usage(argv[0]);
+
+  for (i = 2; i < argc; i++) {
+    if (argv[i][0] != '-') {
+      trace_path = argv[i];
+      continue;
+    }
+    if (i + 1 == argc)
+      usage(argv[0]);
+
+    switch (argv[i][1]) {
+    case 'p': pool_size = strtoul(argv[++i], NULL, 0); break;
+    case 'i': interval = strtoul(argv[++i], NULL, 0); break;
+    case 'n': ops = strtoul(argv[++i], NULL, 0); break;
+    case 's': seed = strtoul(argv[++i], NULL, 0); break;
+    case 'w': trace_path = argv[++i]; break;
+    default: usage(argv[0]);
+    }
+  }
+
+  if (strcmp(argv[1], "replay") == 0 && trace_path != NULL)
+    return replay(trace_path, interval);
+  else if (strcmp(argv[1], "fuzz") == 0)
+    return fuzz(seed, ops, trace_path);
+
+  usage(argv[0]);
+  return 1;
+}
@@ -10,6 +10,7 @@
 #include "base/memmap.h"
 #include "base/assert.h"
 #include "base/util.h"
+#include "base/drivers/usb.h"
 
 #include "base/lib/memalloc/memalloc.h"
 
@@ -22,41 +23,814 @@
 #define printf(fmt, ...) /* Nothing, we don't printf. */
 #include "base/lib/memalloc/_tlsf.c.inc"
 
+#if REAL_FLI != NX_MEMALLOC_FL_CLASSES
+#error "NX_MEMALLOC_FL_CLASSES does not match the TLSF configuration"
+#endif
+
+/* When built with NX_MEMALLOC_TAGS, each block starts with a tag
+ * recording the address of the code that allocated it and the
+ * requested size, for nx_memalloc_dump(). When built with
+ * NX_MEMALLOC_GUARDS, the tag ends with a canary word, and another one
+ * follows the requested size, so that overruns are caught when the
+ * block is freed or by nx_memalloc_check(). The tag is a multiple of the
+ * TLSF alignment, so that the blocks stay aligned.
+ */
+#if defined(NX_MEMALLOC_TAGS) || defined(NX_MEMALLOC_GUARDS)
+struct block_tag {
+#ifdef NX_MEMALLOC_TAGS
+  U32 caller;
+#endif
+  U32 size;
+#ifdef NX_MEMALLOC_GUARDS
+  U32 canary;
+#endif
+};
+#define TAG_SIZE ROUNDUP_SIZE(sizeof(struct block_tag))
+#else
+#define TAG_SIZE 0
+#endif
+
+#ifdef NX_MEMALLOC_GUARDS
+#define CANARY 0xC0DEFACE
+#define GUARD_SIZE sizeof(U32)
+#else
+#define GUARD_SIZE 0
+#endif
+
+/* The memory that the allocator adds to each block. */
+#define EXTRA_SIZE (TAG_SIZE + GUARD_SIZE)
+
+/* A memory pool. The main pool describes the memory given to
+ * nx_memalloc_init_full(). Other pools are carved out of it by
+ * nx_mempool_create(), and start with their descriptor, followed by
+ * their TLSF pool.
+ */
+struct nx_mempool {
+  void *tlsf; /* The TLSF pool. */
+  U8 *end; /* The end of the memory of the pool. */
+  U32 size; /* The size of the memory of the pool. */
+  U32 peak_used;
+  U32 allocs;
+  U32 frees;
+  struct nx_mempool *next; /* The next pool carved out of the main one. */
+};
+
+static nx_mempool_t main_pool;
+
+/* The pools carved out of the main pool. There are only a few of them,
+ * one per subsystem.
+ */
+static nx_mempool_t *pools = NULL;
+
+#define POOL(pool) ((pool) ? (pool) : &main_pool)
+
+/* The relocatable blocks of the main pool. Handles are indices in the
+ * table, plus one. Free entries have no block, and are chained by
+ * their lock count.
+ */
+struct handle {
+  U8 *ptr; /* The user block. */
+  U32 size; /* The size requested for the block. */
+  U32 locks;
+};
+
+static struct {
+  struct handle *table;
+  U32 count;
+  U32 free; /* The first free entry, plus one. */
+  U32 cursor; /* Where the compactor resumes. */
+} handles;
+
+/* Return the pool that the user block @a ptr belongs to. */
+static nx_mempool_t *pool_of(void *ptr) {
+  nx_mempool_t *pool;
+
+  for (pool = pools; pool != NULL; pool = pool->next) {
+    if ((U8*)ptr > (U8*)pool->tlsf && (U8*)ptr < pool->end)
+      return pool;
+  }
+
+  return &main_pool;
+}
+
+/* Set up @a pool over the @a size bytes at @a mem. */
+static bool pool_init(nx_mempool_t *pool, void *mem, U32 size) {
+  char *main_mp = mp;
+  size_t ret;
+
+  if (size < sizeof(tlsf_t) + 128)
+    return FALSE;
+
+  /* TLSF takes memory with its signature as an already initialized
+   * pool, and remembers the last pool initialized as its default one.
+   */
+  if (pool != &main_pool)
+    ((tlsf_t *)mem)->tlsf_signature = 0;
+  ret = init_memory_pool(size, mem);
+  if (pool != &main_pool)
+    mp = main_mp;
+  if (ret == 0 || ret == (size_t)-1)
+    return FALSE;
+
+  memset(pool, 0, sizeof(*pool));
+  pool->tlsf = mem;
+  pool->end = (U8*)mem + size;
+  pool->size = size;
+  pool->peak_used = get_used_size(mem);
+
+  return TRUE;
+}
+
+/* Account for a new or resized block of @a pool. */
+static inline void count_alloc(nx_mempool_t *pool, bool new_block) {
+  if (new_block)
+    pool->allocs++;
+  if (get_used_size(pool->tlsf) > pool->peak_used)
+    pool->peak_used = get_used_size(pool->tlsf);
+}
+
+/* The number of allocator calls in progress. The heap is only
+ * consistent when there are none, see nx_memalloc_check().
+ */
+static volatile U32 busy = 0;
+
+/* The function told about the allocations, if any. */
+static nx_memalloc_trace_hook_t trace_hook = NULL;
+
+static inline void trace(nx_memalloc_op_t op, void *ptr, U32 size,
+                         void *old) {
+  if (trace_hook)
+    trace_hook(op, ptr, size, old);
+}
+
+#ifdef NX_MEMALLOC_GUARDS
+/* The canary after the user block @a ptr of @a size bytes may be
+ * unaligned, so it is accessed byte by byte.
+ */
+static inline void guard_set(U8 *ptr, U32 size) {
+  U32 canary = CANARY, i;
+
+  for (i = 0; i < GUARD_SIZE; i++)
+    ptr[size + i] = canary >> (8 * i);
+}
+
+static inline bool guard_ok(U8 *ptr, U32 size) {
+  U32 canary = 0, i;
+
+  for (i = 0; i < GUARD_SIZE; i++)
+    canary |= (U32)ptr[size + i] << (8 * i);
+  return canary == CANARY;
+}
+
+/* Check the canaries of the user block @a ptr. */
+static inline void guards_check(U8 *ptr) {
+  struct block_tag *tag = (struct block_tag *)(ptr - TAG_SIZE);
+
+  NX_ASSERT_MSG(tag->canary == CANARY, "Heap underrun\nor bad pointer");
+  NX_ASSERT_MSG(guard_ok(ptr, tag->size), "Heap overrun");
+}
+#endif
+
+/* Turn the TLSF block @a block into a user block of @a size bytes
+ * allocated by @a caller.
+ */
+#if defined(NX_MEMALLOC_TAGS) || defined(NX_MEMALLOC_GUARDS)
+static inline void *block_out(void *block, U32 size,
+                              void *caller __attribute__((unused))) {
+  struct block_tag *tag = block;
+  U8 *ptr = (U8*)block + TAG_SIZE;
+
+#ifdef NX_MEMALLOC_TAGS
+  tag->caller = (U32)caller;
+#endif
+  tag->size = size;
+#ifdef NX_MEMALLOC_GUARDS
+  tag->canary = CANARY;
+  guard_set(ptr, size);
+#endif
+
+  return ptr;
+}
+#else
+#define block_out(block, size, caller) (block)
+#endif
+
+/* Return the TLSF block of the user block @a ptr. */
+static inline void *block_in(void *ptr) {
+#ifdef NX_MEMALLOC_GUARDS
+  guards_check(ptr);
+#endif
+  return (U8*)ptr - TAG_SIZE;
+}
+
 void nx_memalloc_init_full(void *mem_pool, U32 mem_pool_size) {
-  size_t size = init_memory_pool(mem_pool_size, mem_pool);
-  NX_ASSERT_MSG(size > 0, "Failed to init\nmemory allocator");
+  bool ok = pool_init(&main_pool, mem_pool, mem_pool_size);
+  NX_ASSERT_MSG(ok, "Failed to init\nmemory allocator");
+  pools = NULL;
+  memset(&handles, 0, sizeof(handles));
 }
 
 void nx_memalloc_init(void) {
   nx_memalloc_init_full(NX_USERSPACE_START, NX_USERSPACE_SIZE);
 }
 
+void nx_memalloc_set_trace_hook(nx_memalloc_trace_hook_t hook) {
+  trace_hook = hook;
+}
+
 U32 nx_memalloc_used(void) {
-  return get_used_size(mp);
+  return get_used_size(main_pool.tlsf);
 }
 
 void nx_memalloc_destroy(void) {
-  destroy_memory_pool(mp);
+  destroy_memory_pool(main_pool.tlsf);
+}
+
+nx_mempool_t *nx_mempool_create(U32 size) {
+  nx_mempool_t *pool;
+  U32 offset = ROUNDUP_SIZE(sizeof(*pool));
+
+  size = ROUNDUP_SIZE(size);
+  busy++;
+  pool = malloc_ex(offset + size + EXTRA_SIZE, main_pool.tlsf);
+  if (pool == NULL)
+    busy--;
+  NX_ASSERT_MSG(pool != NULL, "Out of memory");
+  count_alloc(&main_pool, TRUE);
+  pool = block_out(pool, offset + size, __builtin_return_address(0));
+
+  if (!pool_init(pool, (U8*)pool + offset, size)) {
+    free_ex(block_in(pool), main_pool.tlsf);
+    main_pool.frees++;
+    busy--;
+    return NULL;
+  }
+
+  pool->next = pools;
+  pools = pool;
+  busy--;
+
+  return pool;
+}
+
+U32 nx_mempool_used(nx_mempool_t *pool) {
+  return get_used_size(POOL(pool)->tlsf);
+}
+
+void nx_mempool_destroy(nx_mempool_t *pool) {
+  nx_mempool_t **p = &pools;
+
+  while (*p != pool) {
+    NX_ASSERT_MSG(*p != NULL, "Unknown pool");
+    p = &(*p)->next;
+  }
+  *p = pool->next;
+
+  busy++;
+  destroy_memory_pool(pool->tlsf);
+  free_ex(block_in(pool), main_pool.tlsf);
+  main_pool.frees++;
+  busy--;
+}
+
+void *nx_malloc_from(nx_mempool_t *pool, U32 size) {
+  void *ret;
+
+  pool = POOL(pool);
+  busy++;
+  ret = malloc_ex(size + EXTRA_SIZE, pool->tlsf);
+  if (ret != NULL) {
+    count_alloc(pool, TRUE);
+    ret = block_out(ret, size, __builtin_return_address(0));
+    trace(NX_MEMALLOC_OP_ALLOC, ret, size, NULL);
+  }
+  busy--;
+  return ret;
 }
 
 void *nx_malloc(U32 size) {
-  void *ret = malloc_ex(size, mp);
+  void *ret;
+
+  busy++;
+  ret = malloc_ex(size + EXTRA_SIZE, main_pool.tlsf);
+  if (ret != NULL) {
+    count_alloc(&main_pool, TRUE);
+    ret = block_out(ret, size, __builtin_return_address(0));
+    trace(NX_MEMALLOC_OP_ALLOC, ret, size, NULL);
+  }
+  busy--;
   NX_ASSERT_MSG(ret != NULL, "Out of memory");
   return ret;
 }
 
 void *nx_calloc(U32 nelem, U32 elem_size) {
-  void *ret = calloc_ex(nelem, elem_size, mp);
+  void *ret;
+
+  busy++;
+  ret = malloc_ex(nelem * elem_size + EXTRA_SIZE, main_pool.tlsf);
+  if (ret != NULL) {
+    count_alloc(&main_pool, TRUE);
+    ret = block_out(ret, nelem * elem_size, __builtin_return_address(0));
+    trace(NX_MEMALLOC_OP_ALLOC, ret, nelem * elem_size, NULL);
+  }
+  busy--;
   NX_ASSERT_MSG(ret != NULL, "Out of memory");
+  memset(ret, 0, nelem * elem_size);
   return ret;
 }
 
 void *nx_realloc(void *ptr, U32 size) {
-  void *ret = realloc_ex(ptr, size, mp);
-  NX_ASSERT_MSG(ret != NULL, "Out of memory");
+  nx_mempool_t *pool;
+  void *ret;
+
+  if (size == 0) {
+    nx_free(ptr);
+    return NULL;
+  }
+
+  /* The block stays in its pool. */
+  pool = ptr ? pool_of(ptr) : &main_pool;
+  busy++;
+  ret = realloc_ex(ptr ? block_in(ptr) : NULL, size + EXTRA_SIZE,
+                   pool->tlsf);
+  if (ret != NULL) {
+    count_alloc(pool, ptr == NULL);
+    ret = block_out(ret, size, __builtin_return_address(0));
+    trace(ptr ? NX_MEMALLOC_OP_REALLOC : NX_MEMALLOC_OP_ALLOC,
+          ret, size, ptr);
+  }
+  busy--;
+
+  /* Only the main pool running out of memory is fatal. */
+  NX_ASSERT_MSG(ret != NULL || pool != &main_pool, "Out of memory");
   return ret;
 }
 
 void nx_free(void *ptr) {
-  free_ex(ptr, mp);
+  nx_mempool_t *pool;
+
+  if (ptr == NULL)
+    return;
+
+  trace(NX_MEMALLOC_OP_FREE, ptr, 0, NULL);
+  pool = pool_of(ptr);
+  busy++;
+  pool->frees++;
+  free_ex(block_in(ptr), pool->tlsf);
+  busy--;
+}
+
+void *nx_malloc_aligned(U32 size, U32 align) {
+  U8 *block;
+  void **ret;
+
+  NX_ASSERT_MSG(align != 0 && (align & (align - 1)) == 0,
+                "Alignment not a\npower of 2");
+
+  /* Blocks already have the TLSF alignment. Larger alignments are
+   * obtained by allocating more and skipping the start of the block,
+   * whose address is saved right before the aligned buffer for
+   * nx_free_aligned().
+   */
+  size += align + sizeof(void*);
+  busy++;
+  block = malloc_ex(size + EXTRA_SIZE, main_pool.tlsf);
+  if (block != NULL) {
+    count_alloc(&main_pool, TRUE);
+    block = block_out(block, size, __builtin_return_address(0));
+    trace(NX_MEMALLOC_OP_ALLOC, block, size, NULL);
+  }
+  busy--;
+  NX_ASSERT_MSG(block != NULL, "Out of memory");
+
+  ret = (void**)(((U32)block + sizeof(void*) + align - 1) & ~(align - 1));
+  ret[-1] = block;
+  return ret;
+}
+
+void nx_free_aligned(void *ptr) {
+  if (ptr == NULL)
+    return;
+
+  nx_free(((void**)ptr)[-1]);
+}
+
+void *nx_dma_alloc(U32 size) {
+  void *ret;
+
+  /* TLSF blocks are contiguous and at least word aligned, so a block of
+   * whole words from the main pool is all the PDC needs.
+   */
+  size = (size + sizeof(U32) - 1) & ~(sizeof(U32) - 1);
+  busy++;
+  ret = malloc_ex(size + EXTRA_SIZE, main_pool.tlsf);
+  if (ret != NULL) {
+    count_alloc(&main_pool, TRUE);
+    ret = block_out(ret, size, __builtin_return_address(0));
+    trace(NX_MEMALLOC_OP_ALLOC, ret, size, NULL);
+  }
+  busy--;
+  NX_ASSERT_MSG(ret != NULL, "Out of memory");
+  return ret;
+}
+
+void nx_dma_free(void *ptr) {
+  nx_free(ptr);
+}
+
+/* Return the entry of the valid handle @a h. */
+static inline struct handle *handle_get(nx_handle_t h) {
+  NX_ASSERT_MSG(h > 0 && h <= handles.count &&
+                handles.table[h - 1].ptr != NULL, "Invalid handle");
+  return &handles.table[h - 1];
+}
+
+/* Return a free handle entry, growing the table if needed, or 0 if
+ * there is no memory left for it.
+ */
+static nx_handle_t handle_new(void) {
+  struct handle *grown;
+  U32 i, count;
+
+  if (handles.free == 0) {
+    count = handles.count ? 2 * handles.count : 8;
+    grown = realloc_ex(handles.table ? block_in(handles.table) : NULL,
+                       count * sizeof(*grown) + EXTRA_SIZE, main_pool.tlsf);
+    if (grown == NULL)
+      return 0;
+    count_alloc(&main_pool, handles.table == NULL);
+    grown = block_out(grown, count * sizeof(*grown),
+                      __builtin_return_address(0));
+
+    for (i = handles.count; i < count; i++) {
+      grown[i].ptr = NULL;
+      grown[i].locks = i + 1 < count ? i + 2 : 0;
+    }
+    handles.free = handles.count + 1;
+    handles.table = grown;
+    handles.count = count;
+  }
+
+  return handles.free;
+}
+
+nx_handle_t nx_halloc(U32 size) {
+  struct handle *entry;
+  nx_handle_t h;
+  U8 *block = NULL;
+
+  busy++;
+  h = handle_new();
+  if (h != 0) {
+    /* If the free memory is too scattered, compact it and retry. */
+    block = malloc_ex(size + EXTRA_SIZE, main_pool.tlsf);
+    if (block == NULL && nx_memalloc_compact(0) > 0)
+      block = malloc_ex(size + EXTRA_SIZE, main_pool.tlsf);
+  }
+  if (block != NULL) {
+    count_alloc(&main_pool, TRUE);
+    block = block_out(block, size, __builtin_return_address(0));
+    trace(NX_MEMALLOC_OP_ALLOC, block, size, NULL);
+  }
+  busy--;
+  NX_ASSERT_MSG(block != NULL, "Out of memory");
+
+  entry = &handles.table[h - 1];
+  handles.free = entry->locks;
+  entry->ptr = block;
+  entry->size = size;
+  entry->locks = 0;
+
+  return h;
+}
+
+void *nx_hlock(nx_handle_t h) {
+  struct handle *entry = handle_get(h);
+
+  entry->locks++;
+  return entry->ptr;
+}
+
+void nx_hunlock(nx_handle_t h) {
+  struct handle *entry = handle_get(h);
+
+  NX_ASSERT_MSG(entry->locks > 0, "Handle not locked");
+  entry->locks--;
+}
+
+void nx_hrealloc(nx_handle_t h, U32 size) {
+  struct handle *entry = handle_get(h);
+  U8 *block;
+
+  NX_ASSERT_MSG(entry->locks == 0, "Handle locked");
+
+  busy++;
+  block = realloc_ex(block_in(entry->ptr), size + EXTRA_SIZE,
+                     main_pool.tlsf);
+  if (block == NULL && nx_memalloc_compact(0) > 0)
+    block = realloc_ex(block_in(entry->ptr), size + EXTRA_SIZE,
+                       main_pool.tlsf);
+  if (block != NULL) {
+    count_alloc(&main_pool, FALSE);
+    block = block_out(block, size, __builtin_return_address(0));
+    trace(NX_MEMALLOC_OP_REALLOC, block, size, entry->ptr);
+  }
+  busy--;
+  NX_ASSERT_MSG(block != NULL, "Out of memory");
+
+  entry->ptr = block;
+  entry->size = size;
+}
+
+void nx_hfree(nx_handle_t h) {
+  struct handle *entry;
+
+  if (h == 0)
+    return;
+
+  entry = handle_get(h);
+  NX_ASSERT_MSG(entry->locks == 0, "Handle locked");
+
+  trace(NX_MEMALLOC_OP_FREE, entry->ptr, 0, NULL);
+  busy++;
+  main_pool.frees++;
+  free_ex(block_in(entry->ptr), main_pool.tlsf);
+  busy--;
+
+  entry->ptr = NULL;
+  entry->locks = handles.free;
+  handles.free = h;
+}
+
+/* Slide the used block @a b down over the free block before it, so
+ * that the free space ends up after @a b, merged with the next free
+ * block if any. Return the new header of @a b.
+ */
+static bhdr_t *slide_down(bhdr_t *b) {
+  tlsf_t *tlsf = (tlsf_t *)main_pool.tlsf;
+  bhdr_t *prev = b->prev_hdr, *free_b, *next_b;
+  U32 size = b->size & BLOCK_SIZE, free_size = prev->size & BLOCK_SIZE;
+  U32 *dst, *src, i;
+  int fl, sl;
+
+  MAPPING_INSERT(free_size, &fl, &sl);
+  EXTRACT_BLOCK(prev, tlsf, fl, sl);
+
+  /* The block moves down by the size of the free block and its header,
+   * so the copy must go forward.
+   */
+  dst = (U32 *)prev->ptr.buffer;
+  src = (U32 *)b->ptr.buffer;
+  for (i = 0; i < size / sizeof(U32); i++)
+    dst[i] = src[i];
+  prev->size = size | (prev->size & PREV_STATE);
+
+  free_b = GET_NEXT_BLOCK(prev->ptr.buffer, size);
+  free_b->prev_hdr = prev;
+  free_b->size = free_size | FREE_BLOCK | PREV_USED;
+
+  next_b = GET_NEXT_BLOCK(free_b->ptr.buffer, free_size);
+  if (next_b->size & FREE_BLOCK) {
+    MAPPING_INSERT(next_b->size & BLOCK_SIZE, &fl, &sl);
+    EXTRACT_BLOCK(next_b, tlsf, fl, sl);
+    free_b->size += (next_b->size & BLOCK_SIZE) + BHDR_OVERHEAD;
+    next_b = GET_NEXT_BLOCK(next_b->ptr.buffer, next_b->size & BLOCK_SIZE);
+  }
+  next_b->prev_hdr = free_b;
+  next_b->size |= PREV_FREE;
+
+  MAPPING_INSERT(free_b->size & BLOCK_SIZE, &fl, &sl);
+  INSERT_BLOCK(free_b, tlsf, fl, sl);
+
+  return prev;
+}
+
+/* Go once around the handle table, resuming where the last pass
+ * stopped, and slide the unlocked blocks down until @a max_bytes have
+ * been moved. Return the number of bytes moved.
+ */
+static U32 compact_pass(U32 max_bytes) {
+  struct handle *entry;
+  bhdr_t *b;
+  U8 *ptr;
+  U32 moved = 0, checked;
+
+  for (checked = 0; checked < handles.count && moved < max_bytes; checked++) {
+    if (handles.cursor >= handles.count)
+      handles.cursor = 0;
+    entry = &handles.table[handles.cursor++];
+    if (entry->ptr == NULL || entry->locks > 0)
+      continue;
+
+    b = (bhdr_t *)((U8*)block_in(entry->ptr) - BHDR_OVERHEAD);
+    if (!(b->size & PREV_FREE))
+      continue;
+
+    b = slide_down(b);
+    moved += b->size & BLOCK_SIZE;
+    ptr = (U8*)b->ptr.buffer + TAG_SIZE;
+    trace(NX_MEMALLOC_OP_MOVE, ptr, entry->size, entry->ptr);
+    entry->ptr = ptr;
+  }
+
+  return moved;
+}
+
+U32 nx_memalloc_compact(U32 max_bytes) {
+  U32 moved = 0, pass;
+
+  busy++;
+  if (max_bytes > 0) {
+    moved = compact_pass(max_bytes);
+  } else {
+    /* Moving a block may free the space another one needs to move, so
+     * go on until nothing moves.
+     */
+    do {
+      pass = compact_pass(~0UL);
+      moved += pass;
+    } while (pass > 0);
+  }
+  busy--;
+
+  return moved;
+}
+
+void nx_mempool_get_stats(nx_mempool_t *pool, nx_memalloc_stats_t *stats) {
+  tlsf_t *tlsf;
+  bhdr_t *b;
+  int fl, sl;
+
+  pool = POOL(pool);
+  tlsf = (tlsf_t *)pool->tlsf;
+
+  memset(stats, 0, sizeof(*stats));
+  stats->pool_size = pool->size;
+  stats->used = get_used_size(tlsf);
+  stats->peak_used = pool->peak_used;
+  stats->allocs = pool->allocs;
+  stats->frees = pool->frees;
+  stats->fl_bitmap = tlsf->fl_bitmap;
+
+  /* Only the free lists flagged in the bitmaps are walked. */
+  for (fl = 0; fl < REAL_FLI; fl++) {
+    stats->sl_bitmap[fl] = tlsf->sl_bitmap[fl];
+    for (sl = 0; sl < MAX_SLI; sl++) {
+      if (!(tlsf->sl_bitmap[fl] & (1UL << sl)))
+        continue;
+      for (b = tlsf->matrix[fl][sl]; b != NULL; b = b->ptr.free_ptr.next) {
+        stats->free += b->size & BLOCK_SIZE;
+        stats->free_blocks++;
+        if ((b->size & BLOCK_SIZE) > stats->largest_free)
+          stats->largest_free = b->size & BLOCK_SIZE;
+      }
+    }
+  }
+}
+
+void nx_memalloc_get_stats(nx_memalloc_stats_t *stats) {
+  nx_mempool_get_stats(&main_pool, stats);
+}
+
+/* Dump output buffer. The dump is sent in chunks of a whole number of
+ * USB packets, so that the host sees a single transfer.
+ */
+static struct {
+  U8 buf[192];
+  U32 len;
+} dump;
+
+static void dump_flush(void) {
+  if (dump.len == 0)
+    return;
+
+  nx_usb_write(dump.buf, dump.len);
+  while (!nx_usb_data_written());
+  dump.len = 0;
+}
+
+static void dump_put(const void *data, U32 len) {
+  const U8 *ptr = data;
+
+  while (len > 0) {
+    U32 n = MIN(len, sizeof(dump.buf) - dump.len);
+    memcpy(dump.buf + dump.len, ptr, n);
+    dump.len += n;
+    ptr += n;
+    len -= n;
+    if (dump.len == sizeof(dump.buf))
+      dump_flush();
+  }
+}
+
+/* Return the first block of @a pool. */
+static inline bhdr_t *first_block(nx_mempool_t *pool) {
+  return GET_NEXT_BLOCK(pool->tlsf, ROUNDUP_SIZE(sizeof(tlsf_t)));
+}
+
+/* Return the block following @a b, or NULL if @a b is the sentinel. */
+static inline bhdr_t *next_block(bhdr_t *b) {
+  if ((b->size & BLOCK_SIZE) == 0)
+    return NULL;
+  return GET_NEXT_BLOCK(b->ptr.buffer, b->size & BLOCK_SIZE);
+}
+
+void nx_mempool_dump(nx_mempool_t *pool) {
+  nx_memalloc_stats_t stats;
+  U32 count = 0, size, record[3];
+  bhdr_t *b;
+
+  pool = POOL(pool);
+
+  /* The dump is built on the fly, so that it does not disturb the
+   * heap it describes.
+   */
+  for (b = first_block(pool); b != NULL; b = next_block(b)) {
+    if ((b->size & BLOCK_SIZE) && !(b->size & FREE_BLOCK))
+      count++;
+  }
+  nx_mempool_get_stats(pool, &stats);
+
+  size = sizeof(stats) + sizeof(count) + count * sizeof(record);
+  nx_usb_write((U8*)&size, sizeof(size));
+  while (!nx_usb_data_written());
+
+  dump_put(&stats, sizeof(stats));
+  dump_put(&count, sizeof(count));
+  for (b = first_block(pool); b != NULL; b = next_block(b)) {
+    if (!(b->size & BLOCK_SIZE) || (b->size & FREE_BLOCK))
+      continue;
+
+    record[0] = (U32)b->ptr.buffer + TAG_SIZE;
+#ifdef NX_MEMALLOC_TAGS
+    record[1] = ((struct block_tag *)b->ptr.buffer)->size;
+    record[2] = ((struct block_tag *)b->ptr.buffer)->caller;
+#else
+    record[1] = b->size & BLOCK_SIZE;
+    record[2] = 0;
+#endif
+    dump_put(record, sizeof(record));
+  }
+  dump_flush();
+}
+
+void nx_memalloc_dump(void) {
+  nx_mempool_dump(&main_pool);
+}
+
+/* Check that the free block @a b of @a pool is in the right free list,
+ * and that its neighbours in the list point back at it.
+ */
+static void check_free_block(nx_mempool_t *pool, bhdr_t *b) {
+  tlsf_t *tlsf = (tlsf_t *)pool->tlsf;
+  bhdr_t *prev = b->ptr.free_ptr.prev, *next = b->ptr.free_ptr.next;
+  int fl, sl;
+
+  MAPPING_INSERT(b->size & BLOCK_SIZE, &fl, &sl);
+  NX_ASSERT_MSG((tlsf->fl_bitmap & (1UL << fl)) &&
+                (tlsf->sl_bitmap[fl] & (1UL << sl)),
+                "Heap corrupted\nfree bitmaps");
+  NX_ASSERT_MSG(prev ? prev->ptr.free_ptr.next == b
+                : tlsf->matrix[fl][sl] == b,
+                "Heap corrupted\nfree list");
+  NX_ASSERT_MSG(next == NULL || next->ptr.free_ptr.prev == b,
+                "Heap corrupted\nfree list");
+}
+
+/* Walk the blocks of @a pool, checking their headers, their free lists
+ * and their canaries.
+ */
+static void check_pool(nx_mempool_t *pool) {
+  bhdr_t *b, *next;
+
+  for (b = first_block(pool); (next = next_block(b)) != NULL; b = next) {
+    NX_ASSERT_MSG((U8*)next > (U8*)b && (U8*)next < pool->end,
+                  "Heap corrupted\nblock size");
+    NX_ASSERT_MSG(!(b->size & FREE_BLOCK) == !(next->size & PREV_FREE),
+                  "Heap corrupted\nblock flags");
+
+    if (b->size & FREE_BLOCK) {
+      NX_ASSERT_MSG(next->prev_hdr == b, "Heap corrupted\nblock links");
+      NX_ASSERT_MSG(!(next->size & FREE_BLOCK),
+                    "Heap corrupted\nunmerged blocks");
+      check_free_block(pool, b);
+      continue;
+    }
+#ifdef NX_MEMALLOC_GUARDS
+    guards_check((U8*)b->ptr.buffer + TAG_SIZE);
+#endif
+  }
+}
+
+bool nx_memalloc_check(void) {
+  nx_mempool_t *pool;
+
+  if (busy)
+    return FALSE;
+
+  check_pool(&main_pool);
+  for (pool = pools; pool != NULL; pool = pool->next)
+    check_pool(pool);
+
+  return TRUE;
 }
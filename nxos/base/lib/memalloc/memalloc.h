@@ -42,6 +42,38 @@
 /** @name Controlling the allocator */
 /*@{*/
 
+/** The number of first-level size classes of the allocator. */
+#define NX_MEMALLOC_FL_CLASSES 24
+
+/** Memory allocator statistics, see nx_memalloc_get_stats().
+ *
+ * The allocator sorts free blocks in first-level size classes by power
+ * of 2, each split into 32 second-level classes. Blocks smaller than 128
+ * bytes all go in first-level class 0, and blocks of 2^@e n to
+ * 2^(@e n+1) - 1 bytes in class @e n - 6.
+ *
+ * The ratio of @a largest_free to @a free shows how fragmented the
+ * free memory is.
+ */
+typedef struct {
+  U32 pool_size; /**< The size of the memory pool. */
+  U32 used; /**< The memory in use, including the allocator
+             * overhead. */
+  U32 peak_used; /**< The maximum of @a used since initialization. */
+  U32 free; /**< The total size of the free blocks. */
+  U32 largest_free; /**< The size of the largest free block. */
+  U32 free_blocks; /**< The number of free blocks. */
+  U32 allocs; /**< The number of blocks allocated since
+               * initialization. */
+  U32 frees; /**< The number of blocks freed since initialization. */
+  U32 fl_bitmap; /**< Bit @e i is set if first-level class @e i has
+                  * free blocks. */
+  U32 sl_bitmap[NX_MEMALLOC_FL_CLASSES]; /**< For each first-level
+                                          * class, bit @e j is set if
+                                          * second-level class @e j has
+                                          * free blocks. */
+} nx_memalloc_stats_t;
+
 /** Initialize the allocator's memory pool.
  *
  * After this call, the memory defined in memmap.h as userspace (@a
@@ -74,6 +106,90 @@ void nx_memalloc_init_full(void *mem_pool, U32 mem_pool_size);
  */
 U32 nx_memalloc_used(void);
 
+/** Fill @a stats with the state of the memory allocator.
+ *
+ * @param stats The structure to fill.
+ *
+ * @note This walks the lists of free blocks, and therefore does not
+ * run in constant time.
+ */
+void nx_memalloc_get_stats(nx_memalloc_stats_t *stats);
+
+/** Send the allocator statistics and the list of allocated blocks to
+ * the USB host.
+ *
+ * The dump follows the protocol of usb_console/read_usb_dump.py, and
+ * can be decoded with its @c heap mode. All values are little endian
+ * U32s: the fields of nx_memalloc_stats_t, then the number of allocated
+ * blocks, then for each block its address, its size and the address of
+ * the code that allocated it.
+ *
+ * Allocating code is only recorded when the baseplate is built with
+ * memalloc_tags=1. Each block then takes 8 more bytes, and its size is
+ * the size requested by the caller. Otherwise, the address is 0 and the
+ * size is that of the block.
+ *
+ * @note This call blocks until the whole dump has been sent. It does
+ * not allocate memory.
+ */
+void nx_memalloc_dump(void);
+
+/** Check the consistency of the heap, and assert if it is corrupted.
+ *
+ * This walks all the blocks of the main pool and of the pools carved
+ * out of it, checking their headers and the free lists. When the
+ * baseplate is built with memalloc_guards=1, each allocated block is
+ * also preceded and followed by a canary word, which is checked here as
+ * well as when the block is freed. Each block then takes 12 more bytes,
+ * or 20 with memalloc_tags=1, which TLSF usually rounds up to 16 or 24.
+ *
+ * The check does not allocate memory and uses little stack, so that it
+ * can be run periodically from an idle task, with the scheduler locked.
+ *
+ * @return TRUE if the heap was checked, FALSE if an allocator call was
+ * in progress, in which case the heap may be in the middle of an update
+ * and is not checked.
+ *
+ * @note The walk is linear in the number of blocks.
+ */
+bool nx_memalloc_check(void);
+
+/** The operations reported to the trace hook. */
+typedef enum {
+  NX_MEMALLOC_OP_ALLOC = 0, /**< A block was allocated. */
+  NX_MEMALLOC_OP_REALLOC, /**< A block was resized. */
+  NX_MEMALLOC_OP_FREE, /**< A block was freed. */
+  NX_MEMALLOC_OP_MOVE, /**< A relocatable block was moved by
+                        * nx_memalloc_compact(). */
+} nx_memalloc_op_t;
+
+/** A trace hook, see nx_memalloc_set_trace_hook().
+ *
+ * @param op The operation carried out.
+ * @param ptr The block allocated, resized or freed.
+ * @param size The size requested for the block, or 0 for a free.
+ * @param old For a resize or a move, the address of the block before.
+ */
+typedef void (*nx_memalloc_trace_hook_t)(nx_memalloc_op_t op, void *ptr,
+                                         U32 size, void *old);
+
+/** Set the function called after each allocation, resize and move, and
+ * before each free.
+ *
+ * This is meant to record the allocation patterns of a kernel, so that
+ * they can be replayed on the host by the harness in
+ * base/lib/memalloc/host. For that, the hook stores the @a op, @a ptr,
+ * @a size and @a old of each call as four U32s, and the records are
+ * sent with the protocol of usb_console/read_usb_dump.py, whose @c
+ * memtrace mode saves them to a file.
+ *
+ * @param hook The trace hook, or NULL to disable tracing.
+ *
+ * @warning The hook is called with the allocator in use, and so must
+ * not allocate memory itself.
+ */
+void nx_memalloc_set_trace_hook(nx_memalloc_trace_hook_t hook);
+
 /** Release control over the memory pool.
  *
  * Once destroyed, the allocator can no longer be used, and the caller
@@ -121,6 +237,11 @@ void *nx_calloc(U32 nelem, U32 elem_size);
  * @note As with the standard libc @a realloc, calling nx_realloc() with a
  * NULL @a ptr is equivalent to nx_malloc(size), and calling with a zero @a
  * size is equivalent to nx_free(ptr).
+ *
+ * @note A block of a memory pool created by nx_mempool_create() that
+ * cannot grow within its pool's quota is left as it was, and NULL is
+ * returned, as nx_malloc_from() does. Blocks of the main pool assert
+ * when out of memory, as nx_malloc() does.
  */
 void *nx_realloc(void *ptr, U32 size);
 
@@ -131,6 +252,205 @@ void *nx_realloc(void *ptr, U32 size);
  */
 void nx_free(void *ptr);
 
+/** Allocate and return a pointer to a block of @a size bytes, aligned
+ * to @a align bytes.
+ *
+ * @param size The number of bytes to allocate.
+ * @param align The alignment of the block, in bytes. Must be a power
+ * of 2.
+ * @return A pointer to the allocated block.
+ *
+ * @note The block must be freed with nx_free_aligned(), and cannot be
+ * resized.
+ */
+void *nx_malloc_aligned(U32 size, U32 align);
+
+/** Return memory allocated by nx_malloc_aligned() to the memory pool.
+ *
+ * @param ptr A pointer to a block previously returned by
+ * nx_malloc_aligned().
+ */
+void nx_free_aligned(void *ptr);
+
+/** Allocate and return a buffer of @a size bytes for use by the
+ * peripheral DMA controller.
+ *
+ * The buffer is word aligned, its size is rounded up to a whole number
+ * of words, and it is a single contiguous extent of the main pool. Drivers
+ * can therefore transfer it by words, and hand it over to the PDC
+ * without copying it.
+ *
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the allocated buffer.
+ *
+ * @warning The buffer must not be freed while a transfer is using it.
+ */
+void *nx_dma_alloc(U32 size);
+
+/** Return a buffer allocated by nx_dma_alloc() to the memory pool.
+ *
+ * @param ptr A pointer to a buffer previously returned by
+ * nx_dma_alloc().
+ */
+void nx_dma_free(void *ptr);
+
+/*@}*/
+
+/** @name Relocatable blocks
+ *
+ * Blocks that are resized over and over, or live for long, end up
+ * scattering the free memory in small blocks, until large allocations
+ * fail although there is enough free memory in total. Relocatable
+ * blocks solve this: they are referred to by handles rather than
+ * pointers, so that nx_memalloc_compact() can move them to gather the
+ * free memory.
+ *
+ * To access a relocatable block, lock it with nx_hlock(), which returns
+ * its address. The block stays put until unlocked with nx_hunlock(),
+ * after which the address must no longer be used. Locks nest.
+ */
+/*@{*/
+
+/** A handle on a relocatable block. 0 is never a valid handle. */
+typedef U32 nx_handle_t;
+
+/** Allocate a relocatable block of @a size bytes.
+ *
+ * If the free memory is too fragmented for the allocation, the heap is
+ * compacted and the allocation retried.
+ *
+ * @param size The number of bytes to allocate.
+ * @return A handle on the new block, which is unlocked.
+ */
+nx_handle_t nx_halloc(U32 size);
+
+/** Lock the block of @a h in place, and return its address.
+ *
+ * @param h The handle of the block.
+ * @return The address of the block, valid until it is unlocked.
+ */
+void *nx_hlock(nx_handle_t h);
+
+/** Unlock the block of @a h, locked by nx_hlock().
+ *
+ * @param h The handle of the block.
+ */
+void nx_hunlock(nx_handle_t h);
+
+/** Resize the block of @a h to @a size bytes.
+ *
+ * The contents of the block are kept, as with nx_realloc().
+ *
+ * @param h The handle of the block, which must be unlocked.
+ * @param size The new size of the block.
+ */
+void nx_hrealloc(nx_handle_t h, U32 size);
+
+/** Free the block of @a h.
+ *
+ * @param h The handle of the block, which must be unlocked, or 0.
+ */
+void nx_hfree(nx_handle_t h);
+
+/** Move unlocked relocatable blocks to gather the free memory.
+ *
+ * Each unlocked block that follows free memory is moved down over it,
+ * so that the free memory ends up after the block, where it merges with
+ * any free block that follows. The compaction is incremental: each call
+ * resumes where the last one stopped, and stops once it has moved @a
+ * max_bytes. This makes it cheap enough to call from an idle loop.
+ *
+ * @param max_bytes The maximum number of bytes to move, or 0 to compact
+ * the heap as far as the locked and fixed blocks allow.
+ * @return The number of bytes moved. 0 means that there is nothing
+ * left to move.
+ *
+ * @note The blocks allocated with nx_malloc() and friends never move,
+ * so the compaction is only as good as the share of relocatable blocks
+ * in the heap.
+ */
+U32 nx_memalloc_compact(U32 max_bytes);
+
+/*@}*/
+
+/** @name Memory pools
+ *
+ * By default, all the allocations come from a single pool, so that a
+ * subsystem that leaks or misbehaves can starve all the others. To give
+ * a subsystem (file system buffers, tasks, networking, ...) a fixed
+ * quota of memory, create a pool of that size for it and allocate from
+ * it with nx_malloc_from(). Whatever the subsystem does, it can then
+ * neither use more than its quota nor run out of memory because of
+ * another subsystem.
+ *
+ * Blocks allocated from a pool are resized and freed as usual, with
+ * nx_realloc() and nx_free(). They stay in their pool when resized,
+ * and nx_realloc() returns NULL when the pool is out of memory.
+ */
+/*@{*/
+
+/** A memory pool, carved out of the main pool of the allocator. */
+typedef struct nx_mempool nx_mempool_t;
+
+/** Create a memory pool of @a size bytes.
+ *
+ * The memory of the pool is taken from the main pool at once, so that
+ * it is always available to the pool's users. About 3 KB of it go to
+ * the free lists of the pool, so pools are best kept few and large.
+ *
+ * @param size The size of the pool, including the allocator overhead.
+ * @return The new pool, or NULL if @a size is too small for a pool.
+ */
+nx_mempool_t *nx_mempool_create(U32 size);
+
+/** Allocate and return a pointer to a block of @a size bytes from @a
+ * pool.
+ *
+ * @param pool The pool to allocate from, or NULL for the main pool.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the allocated block, or NULL if @a pool does not
+ * have enough memory left.
+ *
+ * @note Unlike nx_malloc(), this does not assert when out of memory,
+ * since exhausting its quota is something the subsystem should handle.
+ */
+void *nx_malloc_from(nx_mempool_t *pool, U32 size);
+
+/** Return the amount of memory used in @a pool.
+ *
+ * @param pool The pool to query, or NULL for the main pool.
+ * @return The amount of memory used, in bytes, including the allocator
+ * overhead.
+ */
+U32 nx_mempool_used(nx_mempool_t *pool);
+
+/** Fill @a stats with the state of @a pool.
+ *
+ * @param pool The pool to query, or NULL for the main pool.
+ * @param stats The structure to fill.
+ *
+ * @sa nx_memalloc_get_stats()
+ */
+void nx_mempool_get_stats(nx_mempool_t *pool, nx_memalloc_stats_t *stats);
+
+/** Send the statistics and the allocated blocks of @a pool to the USB
+ * host, as nx_memalloc_dump() does for the main pool.
+ *
+ * @param pool The pool to dump, or NULL for the main pool.
+ *
+ * @note In the main pool, each pool shows up as a single allocated
+ * block.
+ */
+void nx_mempool_dump(nx_mempool_t *pool);
+
+/** Destroy @a pool, and return its memory to the main pool.
+ *
+ * @param pool The pool to destroy.
+ *
+ * @warning The blocks still allocated from @a pool become invalid.
+ */
+void nx_mempool_destroy(nx_mempool_t *pool);
+
 /*@}*/
 
 /*@}*/
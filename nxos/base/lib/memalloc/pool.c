@@ -0,0 +1,91 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/util.h"
+
+#include "base/lib/memalloc/memalloc.h"
+#include "base/lib/memalloc/pool.h"
+
+/* Objects are multiples of the machine word, large enough to hold the
+ * free list link.
+ */
+#define WORD_MASK (sizeof(void*) - 1)
+#define ROUNDUP_WORD(size) (((size) + WORD_MASK) & ~WORD_MASK)
+
+/* The pool descriptor sits at the start of the slab, followed by the
+ * objects. Free objects start with a pointer to the next free object.
+ */
+struct nx_pool {
+  void *free; /* The first free object, or NULL. */
+  U8 *start; /* The first object. */
+  U8 *end; /* The end of the last object. */
+  U32 obj_size;
+  U32 available;
+};
+
+nx_pool_t *nx_pool_create(U32 obj_size, U32 count) {
+  nx_pool_t *pool;
+  U8 *obj;
+  U32 i;
+
+  NX_ASSERT(count > 0);
+
+  obj_size = ROUNDUP_WORD(MAX(obj_size, sizeof(void*)));
+  NX_ASSERT_MSG(count <= ((U32)-1 - ROUNDUP_WORD(sizeof(*pool))) / obj_size,
+                "Pool too large");
+
+  pool = nx_malloc(ROUNDUP_WORD(sizeof(*pool)) + obj_size * count);
+  pool->start = (U8*)pool + ROUNDUP_WORD(sizeof(*pool));
+  pool->end = pool->start + obj_size * count;
+  pool->obj_size = obj_size;
+  pool->available = count;
+
+  /* Thread the free list through the objects, in address order. */
+  obj = pool->start;
+  for (i = 0; i < count - 1; i++, obj += obj_size)
+    *(void**)obj = obj + obj_size;
+  *(void**)obj = NULL;
+  pool->free = pool->start;
+
+  return pool;
+}
+
+void *nx_pool_alloc(nx_pool_t *pool) {
+  void *obj = pool->free;
+
+  if (obj != NULL) {
+    pool->free = *(void**)obj;
+    pool->available--;
+  }
+
+  return obj;
+}
+
+void nx_pool_free(nx_pool_t *pool, void *obj) {
+  if (obj == NULL)
+    return;
+
+  NX_ASSERT_MSG((U8*)obj >= pool->start && (U8*)obj < pool->end,
+                "Object not from\nthis pool");
+  NX_ASSERT_MSG(((U8*)obj - pool->start) % pool->obj_size == 0,
+                "Object not at\nslot start");
+
+  *(void**)obj = pool->free;
+  pool->free = obj;
+  pool->available++;
+}
+
+U32 nx_pool_available(nx_pool_t *pool) {
+  return pool->available;
+}
+
+void nx_pool_destroy(nx_pool_t *pool) {
+  nx_free(pool);
+}
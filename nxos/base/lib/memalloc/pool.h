@@ -0,0 +1,90 @@
+/** @file pool.h
+ *  @brief Fixed-size object pools.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_MEMALLOC_POOL_H__
+#define __NXOS_BASE_MEMALLOC_POOL_H__
+
+#include "base/types.h"
+
+/** @addtogroup lib */
+/*@{*/
+
+/** @defgroup pool Object pools
+ *
+ * An object pool hands out objects of a single size from a slab
+ * carved out of the memory allocator once, when the pool is created.
+ * Allocating and freeing objects then only takes a couple of pointer
+ * operations on a free list threaded through the free objects, without
+ * any per-object header.
+ *
+ * Pools suit small objects that are created and destroyed often, such
+ * as kernel object descriptors: they no longer fragment the heap, nor
+ * pay the overhead of the general purpose allocator.
+ *
+ * @note Like the memory allocator, pools are @b not safe for concurrent
+ * access. You must provide your own locking around them if you are
+ * going to use them from concurrent contexts.
+ */
+/*@{*/
+
+typedef struct nx_pool nx_pool_t;
+
+/** Create a pool of @a count objects of @a obj_size bytes.
+ *
+ * The memory for all the objects is taken from the memory allocator at
+ * once.
+ *
+ * @param obj_size The size of the objects, in bytes.
+ * @param count The number of objects in the pool.
+ * @return The new pool.
+ *
+ * @note Objects are aligned on, and their size rounded up to, a
+ * multiple of the machine word size.
+ */
+nx_pool_t *nx_pool_create(U32 obj_size, U32 count);
+
+/** Allocate an object from @a pool.
+ *
+ * @param pool The pool to allocate from.
+ * @return A pointer to the object, or NULL if all the objects of @a
+ * pool are in use.
+ *
+ * @note The content of the object is undefined.
+ */
+void *nx_pool_alloc(nx_pool_t *pool);
+
+/** Return @a obj to @a pool.
+ *
+ * @param pool The pool @a obj was allocated from.
+ * @param obj The object to free.
+ */
+void nx_pool_free(nx_pool_t *pool, void *obj);
+
+/** Return the number of free objects in @a pool.
+ *
+ * @param pool The pool to query.
+ * @return The number of objects that can still be allocated.
+ */
+U32 nx_pool_available(nx_pool_t *pool);
+
+/** Destroy @a pool, and give its memory back to the memory allocator.
+ *
+ * @param pool The pool to destroy.
+ *
+ * @warning Any object still allocated from @a pool becomes invalid.
+ */
+void nx_pool_destroy(nx_pool_t *pool);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_MEMALLOC_POOL_H__ */
@@ -0,0 +1,144 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/drivers/systick.h"
+
+#include "base/_timer.h"
+
+#define WHEEL_SIZE 64
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+
+/* The timer wheel. Each slot holds the running timers whose expiry
+ * time, modulo the size of the wheel, is the slot index, in no
+ * particular order. Timers that expire more than a turn of the wheel
+ * away just stay in their slot until their turn comes.
+ *
+ * The wheel is only accessed with interrupts disabled, as timers may
+ * be started and stopped from any interrupt handler.
+ */
+static struct {
+  nx_timer_t *slots[WHEEL_SIZE];
+  U32 count; /* The number of running timers. */
+  U32 now; /* The last tick whose timers were run. */
+} wheel;
+
+static void timer_link(nx_timer_t *timer) {
+  nx_timer_t **slot = &wheel.slots[timer->expires & WHEEL_MASK];
+
+  timer->next = *slot;
+  if (timer->next)
+    timer->next->pprev = &timer->next;
+  timer->pprev = slot;
+  *slot = timer;
+  wheel.count++;
+}
+
+static void timer_unlink(nx_timer_t *timer) {
+  *timer->pprev = timer->next;
+  if (timer->next)
+    timer->next->pprev = timer->pprev;
+  timer->pprev = NULL;
+  wheel.count--;
+}
+
+void nx_timer_init(nx_timer_t *timer) {
+  timer->func = NULL;
+  timer->expires = 0;
+  timer->period = 0;
+  timer->next = NULL;
+  timer->pprev = NULL;
+}
+
+void nx_timer_start(nx_timer_t *timer, U32 period_ms,
+                    nx_timer_func_t func, bool periodic) {
+  NX_ASSERT(period_ms > 0);
+
+  nx_interrupts_disable();
+  if (timer->pprev)
+    timer_unlink(timer);
+
+  /* Without running timers, the wheel is not kept up to date. */
+  if (wheel.count == 0)
+    wheel.now = nx_systick_get_ms();
+
+  /* The system time may be ahead of the wheel, if the interrupt is
+   * held up. Counting from it ensures the timer does not expire early.
+   */
+  timer->func = func;
+  timer->expires = nx_systick_get_ms() + period_ms;
+  timer->period = periodic ? period_ms : 0;
+  timer_link(timer);
+  nx_interrupts_enable();
+}
+
+void nx_timer_stop(nx_timer_t *timer) {
+  nx_interrupts_disable();
+  if (timer->pprev)
+    timer_unlink(timer);
+  nx_interrupts_enable();
+}
+
+bool nx_timer_is_running(nx_timer_t *timer) {
+  return timer->pprev != NULL;
+}
+
+bool nx__timer_running(void) {
+  return wheel.count > 0;
+}
+
+/* Run the timers expiring at @a now. Must be called with interrupts
+ * disabled, which are enabled while the timer functions run.
+ */
+static void timer_expire(U32 now) {
+  nx_timer_t **slot = &wheel.slots[now & WHEEL_MASK];
+  nx_timer_t *timer = *slot;
+
+  while (timer != NULL) {
+    if (timer->expires != now) {
+      timer = timer->next;
+      continue;
+    }
+
+    /* Periodic timers are rearmed from their expiry time rather than
+     * from the current time, so that they do not drift.
+     */
+    timer_unlink(timer);
+    if (timer->period) {
+      timer->expires += timer->period;
+      timer_link(timer);
+    }
+
+    nx_interrupts_enable();
+    timer->func(timer);
+    nx_interrupts_disable();
+
+    /* The timer function may have changed the slot, so look at it
+     * again. The timers rearmed in this slot expire later, and are
+     * skipped.
+     */
+    timer = *slot;
+  }
+}
+
+void nx__timer_irq(void) {
+  U32 time = nx_systick_get_ms();
+
+  nx_interrupts_disable();
+  if (wheel.count == 0)
+    wheel.now = time;
+
+  /* Catch up with the ticks that went by since the last run. */
+  while (wheel.now != time) {
+    wheel.now++;
+    timer_expire(wheel.now);
+  }
+  nx_interrupts_enable();
+}
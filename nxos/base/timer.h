@@ -0,0 +1,111 @@
+/** @file timer.h
+ *  @brief Software timers.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_BASE_TIMER_H__
+#define __NXOS_BASE_TIMER_H__
+
+#include "base/types.h"
+
+/** @addtogroup kernel */
+/*@{*/
+
+/** @defgroup timer Software timers
+ *
+ * Software timers call a function after some milliseconds, once or
+ * periodically. They let drivers and application kernels share the
+ * system timer tick, instead of polling nx_systick_get_ms() or taking
+ * over the single scheduler callback of the system timer.
+ *
+ * Timers are kept in a timer wheel, indexed by their expiry time, so
+ * that starting and stopping a timer takes constant time, and each
+ * tick only looks at the timers expiring around then. The timers run
+ * in the low priority system timer interrupt, which is only triggered
+ * every millisecond while timers are running.
+ */
+/*@{*/
+
+/** A software timer. */
+typedef struct nx_timer nx_timer_t;
+
+/** A timer function, called with the timer that expired.
+ *
+ * Timer functions run in the low priority system timer interrupt, with
+ * higher priority interrupts enabled. They must be short, and must not
+ * block. They may start and stop timers, including their own.
+ */
+typedef void (*nx_timer_func_t)(nx_timer_t *timer);
+
+/** A software timer. The fields are private, and should only be used
+ * through the functions below. A timer must be initialized with
+ * nx_timer_init() before it is first started.
+ */
+struct nx_timer {
+  nx_timer_func_t func; /**< The function to call on expiry. */
+  U32 expires; /**< The time of the next expiry, in milliseconds. */
+  U32 period; /**< The period of a periodic timer, or 0. */
+  struct nx_timer *next; /**< The next timer in the wheel slot. */
+  struct nx_timer **pprev; /**< The link to this timer in the wheel
+                              slot, or NULL if the timer is stopped. */
+};
+
+/** Initialize @a timer, stopped.
+ *
+ * @param timer The timer to initialize.
+ *
+ * @note This must not be called on a running timer.
+ */
+void nx_timer_init(nx_timer_t *timer);
+
+/** Start @a timer, to call @a func in @a period_ms milliseconds.
+ *
+ * If @a timer is already running, it is restarted.
+ *
+ * @param timer The timer to start, initialized by nx_timer_init().
+ * @param period_ms The time before the expiry, in milliseconds. May not
+ * be zero.
+ * @param func The function to call on expiry.
+ * @param periodic If TRUE, @a timer expires every @a period_ms
+ * milliseconds until it is stopped, otherwise only once.
+ *
+ * @note The timer expires at the system timer tick @a period_ms
+ * milliseconds after the current one, that is after @a period_ms - 1
+ * to @a period_ms milliseconds. The expiries of a periodic timer do
+ * not drift, even if the interrupt is held up.
+ *
+ * @note This function never blocks, and can be called from any
+ * interrupt handler, or from normal code.
+ */
+void nx_timer_start(nx_timer_t *timer, U32 period_ms,
+                    nx_timer_func_t func, bool periodic);
+
+/** Stop @a timer.
+ *
+ * @param timer The timer to stop. If it is not running, nothing
+ * happens.
+ *
+ * @note A timer stopped by a higher priority interrupt handler as it
+ * expires may still have its function called one last time.
+ */
+void nx_timer_stop(nx_timer_t *timer);
+
+/** Check if @a timer is running.
+ *
+ * @param timer The timer to check.
+ * @return TRUE if @a timer will expire, FALSE if it is stopped. A
+ * one-shot timer is stopped before its function is called.
+ */
+bool nx_timer_is_running(nx_timer_t *timer);
+
+/*@}*/
+/*@}*/
+
+#endif /* __NXOS_BASE_TIMER_H__ */
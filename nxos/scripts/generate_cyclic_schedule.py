@@ -0,0 +1,111 @@
+#!/usr/bin/env python
+#
+# "Compile" the job table of a cyclic executive into its schedule
+# table.
+#
+# The job table is a C header listing the jobs as
+#
+#   CYCLIC_JOB(function, period, offset)
+#
+# with the period and offset in milliseconds. The generated header
+# defines the minor frame length (the greatest common divisor of all
+# the periods and offsets), the hyperperiod (the least common multiple
+# of all the periods), and for each minor frame of the hyperperiod the
+# bitmask of the jobs released at its start. Bit i stands for the i-th
+# job of the table.
+#
+
+import re
+import sys
+
+JOB_RE = re.compile(r'^\s*CYCLIC_JOB\(\s*(\w+)\s*,\s*(\d+)\s*,\s*(\d+)\s*\)')
+
+# Upper bounds, to keep the job masks in a U32 and the table small.
+MAX_JOBS = 32
+MAX_FRAMES = 1024
+
+
+def error(msg):
+    sys.stderr.write("ERROR: %s\n" % msg)
+    sys.exit(1)
+
+
+def gcd(a, b):
+    while b:
+        a, b = b, a % b
+    return a
+
+
+def parse_jobs(job_file):
+    jobs = []
+    for line in open(job_file):
+        match = JOB_RE.match(line)
+        if not match:
+            continue
+        name, period, offset = (match.group(1), int(match.group(2)),
+                                int(match.group(3)))
+        if period == 0:
+            error("job %s has a null period" % name)
+        if offset >= period:
+            error("job %s has an offset beyond its period" % name)
+        jobs.append((name, period, offset))
+
+    if not jobs:
+        error("no CYCLIC_JOB entries in %s" % job_file)
+    if len(jobs) > MAX_JOBS:
+        error("more than %d jobs" % MAX_JOBS)
+    return jobs
+
+
+def build_schedule(jobs):
+    frame = 0
+    hyperperiod = 1
+    for name, period, offset in jobs:
+        frame = gcd(frame, gcd(period, offset))
+        hyperperiod = hyperperiod * period // gcd(hyperperiod, period)
+
+    frames = hyperperiod // frame
+    if frames > MAX_FRAMES:
+        error("the hyperperiod of %d ms needs %d frames of %d ms, "
+              "more than %d" % (hyperperiod, frames, frame, MAX_FRAMES))
+
+    table = []
+    for i in range(frames):
+        time = i * frame
+        mask = 0
+        for bit, (name, period, offset) in enumerate(jobs):
+            if time % period == offset:
+                mask |= 1 << bit
+        table.append(mask)
+
+    return frame, hyperperiod, table
+
+
+def main():
+    if len(sys.argv) != 3:
+        error("usage: %s <job table> <schedule header>" % sys.argv[0])
+
+    jobs = parse_jobs(sys.argv[1])
+    frame, hyperperiod, table = build_schedule(jobs)
+
+    out = open(sys.argv[2], 'w')
+    out.write("/* Generated by scripts/generate_cyclic_schedule.py from %s.\n"
+              " * Do not edit.\n"
+              " *\n" % sys.argv[1])
+    for bit, (name, period, offset) in enumerate(jobs):
+        out.write(" * Job %d: %s, every %d ms from %d ms.\n"
+                  % (bit, name, period, offset))
+    out.write(" */\n\n")
+    out.write("#define CYCLIC_JOBS %d\n" % len(jobs))
+    out.write("#define CYCLIC_FRAME_MS %d\n" % frame)
+    out.write("#define CYCLIC_HYPERPERIOD_MS %d\n" % hyperperiod)
+    out.write("#define CYCLIC_FRAMES %d\n\n" % len(table))
+    out.write("static const U32 cyclic_schedule[CYCLIC_FRAMES] = {\n")
+    for i, mask in enumerate(table):
+        out.write("  0x%08x, /* %d ms */\n" % (mask, i * frame))
+    out.write("};\n")
+    out.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,84 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/interrupts.h"
+#include "base/drivers/systick.h"
+
+#include "cyclic/cyclic.h"
+
+/* Generated from jobs.h by scripts/generate_cyclic_schedule.py: the
+ * minor frame length, the number of frames in the hyperperiod and, for
+ * each frame, the bitmask of the jobs to run.
+ */
+#include "cyclic/_schedule.h"
+
+/* The job functions, in the order of the schedule bitmasks. */
+static const nx_closure_t jobs[CYCLIC_JOBS] = {
+#define CYCLIC_JOB(function, period, offset) function,
+#include "cyclic/jobs.h"
+#undef CYCLIC_JOB
+};
+
+static volatile struct {
+  U32 frame; /* The index of the next frame to run. */
+  U32 release; /* The release time of that frame. */
+  U32 overruns;
+} cyclic;
+
+/* The systick scheduler callback. It runs every millisecond, and also
+ * whenever interrupt handlers defer work, so the frames are released
+ * based on the time rather than on the number of calls.
+ */
+static void cyclic_dispatch(void) {
+  U32 now = nx_systick_get_ms();
+  U32 late, mask, i;
+
+  if ((S32)(now - cyclic.release) < 0)
+    return;
+
+  /* If whole frames have gone by, skip them rather than running the
+   * jobs in a burst. This is the only place that divides, and it only
+   * happens on overrun.
+   */
+  late = now - cyclic.release;
+  if (late >= CYCLIC_FRAME_MS) {
+    late /= CYCLIC_FRAME_MS;
+    cyclic.overruns += late;
+    cyclic.release += late * CYCLIC_FRAME_MS;
+    cyclic.frame = (cyclic.frame + late) % CYCLIC_FRAMES;
+  }
+
+  mask = cyclic_schedule[cyclic.frame];
+  for (i = 0; mask != 0; i++, mask >>= 1) {
+    if (mask & 1)
+      jobs[i]();
+  }
+
+  cyclic.release += CYCLIC_FRAME_MS;
+  if (++cyclic.frame == CYCLIC_FRAMES)
+    cyclic.frame = 0;
+}
+
+void cyclic_start(void) {
+  nx_interrupts_disable();
+  cyclic.frame = 0;
+  cyclic.release = nx_systick_get_ms() + 1;
+  cyclic.overruns = 0;
+  nx_interrupts_enable();
+
+  nx_systick_install_scheduler(cyclic_dispatch);
+}
+
+void cyclic_stop(void) {
+  nx_systick_install_scheduler(NULL);
+}
+
+U32 cyclic_get_overruns(void) {
+  return cyclic.overruns;
+}
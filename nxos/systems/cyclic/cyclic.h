@@ -0,0 +1,50 @@
+/** @file cyclic.h
+ *  @brief Static cyclic executive.
+ *
+ * Runs the jobs listed in jobs.h according to a schedule table that is
+ * computed at build time. The jobs run from the systick scheduler
+ * callback: there are no tasks, no context switches and no heap usage.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_CYCLIC_CYCLIC_H__
+#define __NXOS_CYCLIC_CYCLIC_H__
+
+#include "base/types.h"
+
+/* Prototypes of the job functions. */
+#define CYCLIC_JOB(function, period, offset) void function(void);
+#include "cyclic/jobs.h"
+#undef CYCLIC_JOB
+
+/** Start running the jobs.
+ *
+ * The first minor frame starts on the next millisecond tick.
+ *
+ * @warning The jobs run in the low priority system interrupt handler.
+ * They must not block, and should return well within a minor frame.
+ */
+void cyclic_start(void);
+
+/** Stop running the jobs.
+ *
+ * @note Jobs that are running when this is called are completed.
+ */
+void cyclic_stop(void);
+
+/** Return the number of minor frames skipped since cyclic_start().
+ *
+ * A frame is skipped when the jobs of the previous frames have run
+ * past its release time. The schedule then resumes at the current
+ * frame, so that the jobs keep their phase.
+ */
+U32 cyclic_get_overruns(void);
+
+#endif /* __NXOS_CYCLIC_CYCLIC_H__ */
@@ -0,0 +1,26 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+/* The job table of the cyclic executive.
+ *
+ * Each entry reads CYCLIC_JOB(function, period, offset): the job
+ * function is called every period milliseconds, starting offset
+ * milliseconds after cyclic_start(). The offset must be lower than the
+ * period.
+ *
+ * This file is included several times with different definitions of
+ * CYCLIC_JOB, and parsed by scripts/generate_cyclic_schedule.py at
+ * build time, so it must contain nothing but the entries. The minor
+ * frame of the schedule is the greatest common divisor of all the
+ * periods and offsets: keep them multiples of a common value, or the
+ * schedule table will grow large.
+ */
+
+CYCLIC_JOB(job_control, 10, 0)
+CYCLIC_JOB(job_sensors, 20, 5)
+CYCLIC_JOB(job_display, 100, 15)
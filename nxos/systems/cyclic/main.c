@@ -0,0 +1,62 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+/** Static cyclic executive demo.
+ *
+ * Runs the sample jobs of jobs.h, and displays how many times each one
+ * ran until the cancel button is pressed.
+ */
+
+#include "base/types.h"
+#include "base/display.h"
+#include "base/drivers/avr.h"
+#include "base/drivers/systick.h"
+
+#include "cyclic/cyclic.h"
+
+static volatile U32 control_runs, sensors_runs, display_runs;
+static volatile bool cancel;
+
+/* Every 10ms: stands for a control loop. */
+void job_control(void) {
+  control_runs++;
+}
+
+/* Every 20ms, 5ms after the control job: polls the buttons. */
+void job_sensors(void) {
+  sensors_runs++;
+  if (nx_avr_get_button() == BUTTON_CANCEL)
+    cancel = TRUE;
+}
+
+/* Every 100ms, in a frame that the other jobs leave free. */
+void job_display(void) {
+  display_runs++;
+}
+
+static void show(const char *name, U32 value) {
+  nx_display_string(name);
+  nx_display_uint(value);
+  nx_display_end_line();
+}
+
+void main(void) {
+  cyclic_start();
+
+  while (!cancel) {
+    nx_display_clear();
+    nx_display_string("Cyclic executive\n\n");
+    show("control: ", control_runs);
+    show("sensors: ", sensors_runs);
+    show("display: ", display_runs);
+    show("overruns: ", cyclic_get_overruns());
+    nx_systick_wait_ms(200);
+  }
+
+  cyclic_stop();
+}
@@ -15,6 +15,35 @@
 
 #include "marvin/scheduler.h"
 
+/** A task waiting in a wait queue. */
+struct mv__waiter {
+  mv_task_t *task; /**< The waiting task. */
+  void *arg; /**< What the task waits for, see mv__scheduler_wait_arg(). */
+  struct mv__waiter *prev, *next; /**< Wait queue links, see list.h. */
+};
+
+/** A wakeup posted by an interrupt handler, see mv__scheduler_wake_isr(). */
+struct mv__isr_post {
+  struct mv__isr_post *volatile next; /**< The next posted wakeup. */
+  struct mv__wait_queue *queue; /**< The wait queue to wake up. */
+  volatile U8 posted; /**< Non-zero while the wakeup is pending. */
+};
+
+/** A queue of tasks waiting for some event.
+ *
+ * A zero-filled wait queue is empty and ready for use.
+ */
+typedef struct mv__wait_queue {
+  struct mv__waiter *waiters; /**< The waiting tasks, see list.h. */
+  struct mv__isr_post post; /**< Wakeup posted by interrupt handlers. */
+
+  /** If set, called with the wait argument of each waiter when all the
+   * waiters are woken up, to only wake up those whose condition is
+   * met. It is called with the scheduler locked.
+   */
+  bool (*match)(struct mv__wait_queue *queue, void *arg);
+} mv__wait_queue_t;
+
 /** Initialize the scheduler. */
 void mv__scheduler_init(void);
 
@@ -46,4 +75,70 @@ void mv__scheduler_task_unblock(mv_task_t *task);
  */
 void mv__scheduler_task_suspend(U32 time);
 
+/** Block the current task on @a queue for at most @a timeout
+ * milliseconds.
+ *
+ * The scheduler must be locked exactly once by the caller. The lock is
+ * released while the task is blocked, and taken again before
+ * returning. Callers should therefore check the condition they wait
+ * for again after waking up.
+ *
+ * @param queue The wait queue to block on.
+ * @param timeout The maximum time to wait in milliseconds, or
+ * MV_TIMEOUT_INFINITE. A zero timeout returns immediately.
+ * @return TRUE if the task was woken up, FALSE if the wait timed out.
+ */
+bool mv__scheduler_wait(mv__wait_queue_t *queue, U32 timeout);
+
+/** Block the current task on @a queue for at most @a timeout
+ * milliseconds, waiting for the condition described by @a arg.
+ *
+ * Same as mv__scheduler_wait(), except that @a arg is given to the
+ * match function of @a queue to check whether the task should be woken
+ * up by mv__scheduler_wake_all().
+ *
+ * @param queue The wait queue to block on.
+ * @param timeout The maximum time to wait in milliseconds, or
+ * MV_TIMEOUT_INFINITE. A zero timeout returns immediately.
+ * @param arg The wait argument, which must stay valid while the task
+ * waits.
+ * @return TRUE if the task was woken up, FALSE if the wait timed out.
+ */
+bool mv__scheduler_wait_arg(mv__wait_queue_t *queue, U32 timeout, void *arg);
+
+/** Wake up the first task waiting on @a queue.
+ *
+ * The scheduler must be locked by the caller.
+ *
+ * @param queue The wait queue to wake up.
+ * @return TRUE if a task was woken up, FALSE if the queue was empty.
+ */
+bool mv__scheduler_wake_one(mv__wait_queue_t *queue);
+
+/** Wake up all the tasks waiting on @a queue whose condition is met.
+ *
+ * The waiters are checked against the match function of @a queue in a
+ * single pass, in their order of arrival. If @a queue has no match
+ * function, all the waiters are woken up. The scheduler must be locked
+ * by the caller.
+ *
+ * @param queue The wait queue to wake up.
+ * @return The number of tasks woken up.
+ */
+U32 mv__scheduler_wake_all(mv__wait_queue_t *queue);
+
+/** Wake up all the tasks waiting on @a queue from an interrupt handler.
+ *
+ * The wakeup is posted to a lock-free queue, which the scheduler drains
+ * as soon as no task holds the scheduler lock, as with
+ * mv__scheduler_wake_all(). Posting a wakeup on a queue that already
+ * has one pending does nothing more. As all the waiters are woken up,
+ * they should check the condition they wait for again.
+ *
+ * @param queue The wait queue to wake up.
+ *
+ * @note This may be called from any interrupt handler, and from tasks.
+ */
+void mv__scheduler_wake_isr(mv__wait_queue_t *queue);
+
 #endif /* __NXOS_MARVIN__SCHEDULER_H__ */
@@ -19,4 +19,10 @@ void mv__task_run_first(nx_closure_t func, U32 *stack);
 U32 *mv__task_get_stack(void);
 void mv__task_set_stack(U32 *stack);
 
+/* Return TRUE if the CPU runs in the mode of tasks with interrupts
+ * enabled, and not in an interrupt handler, with interrupts disabled,
+ * or before the scheduler started.
+ */
+bool mv__task_in_task_mode(void);
+
 #endif /* __NXOS_MARVIN__TASK_H__ */
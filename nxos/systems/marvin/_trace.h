@@ -0,0 +1,31 @@
+/** @file _trace.h
+ *  @brief Scheduler event tracing internal interface.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN__TRACE_H__
+#define __NXOS_MARVIN__TRACE_H__
+
+#include "base/types.h"
+#include "marvin/scheduler.h"
+#include "marvin/trace.h"
+
+/** Record an event of @a type for @a task, if tracing is on.
+ *
+ * @param type The event type.
+ * @param task The task concerned.
+ * @param object The semaphore concerned, or NULL.
+ *
+ * @note The scheduler must be locked by the caller, which serializes
+ * the writers of the trace buffer.
+ */
+void mv__trace(mv_trace_event_type_t type, mv_task_t *task, void *object);
+
+#endif /* __NXOS_MARVIN__TRACE_H__ */
@@ -0,0 +1,156 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/drivers/systick.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/list.h"
+#include "marvin/_scheduler.h"
+
+#include "marvin/event.h"
+
+struct mv_event_group {
+  /* The waiting tasks. This must come first, for the match function to
+   * find the group from its wait queue.
+   */
+  mv__wait_queue_t waiters;
+
+  /* The event flags. They are set and cleared by interrupt handlers
+   * too, so they are only ever modified with interrupts disabled.
+   */
+  volatile U32 flags;
+};
+
+/* The wait condition of a task, passed as its wait argument. */
+struct event_wait {
+  U32 flags;
+  U32 options;
+};
+
+/* Check whether the flags in @a flags satisfy @a wait. */
+static inline bool event_match(U32 flags, struct event_wait *wait) {
+  if (wait->options & MV_EVENT_WAIT_ALL)
+    return (flags & wait->flags) == wait->flags;
+  else
+    return (flags & wait->flags) != 0;
+}
+
+/* Wait queue match function, for the scheduler to only wake up the
+ * tasks whose condition is met.
+ */
+static bool event_wake_match(mv__wait_queue_t *queue, void *arg) {
+  mv_event_group_t *group = (mv_event_group_t*)queue;
+
+  return event_match(group->flags, arg);
+}
+
+/* Return the awaited flags if @a wait is satisfied, consuming them if
+ * requested, or 0.
+ */
+static U32 event_check(mv_event_group_t *group, struct event_wait *wait) {
+  U32 matched = 0;
+
+  nx_interrupts_disable();
+  if (event_match(group->flags, wait)) {
+    matched = group->flags & wait->flags;
+    if (wait->options & MV_EVENT_CLEAR)
+      group->flags &= ~wait->flags;
+  }
+  nx_interrupts_enable();
+
+  return matched;
+}
+
+mv_event_group_t *mv_event_group_create(void) {
+  mv_event_group_t *group = nx_calloc(1, sizeof(*group));
+
+  group->waiters.match = event_wake_match;
+
+  return group;
+}
+
+U32 mv_event_group_wait(mv_event_group_t *group, U32 flags, U32 options,
+                        U32 timeout) {
+  U32 deadline = nx_systick_get_ms() + timeout;
+  struct event_wait wait = { flags, options };
+  U32 matched;
+
+  NX_ASSERT(flags != 0);
+
+  mv_scheduler_lock();
+
+  /* The task is only woken up once its condition is met, but another
+   * task may consume the flags first, in which case the wait is
+   * resumed for the remaining time only.
+   */
+  while ((matched = event_check(group, &wait)) == 0) {
+    if (timeout != MV_TIMEOUT_INFINITE) {
+      U32 now = nx_systick_get_ms();
+      timeout = (deadline > now) ? deadline - now : 0;
+    }
+
+    if (!mv__scheduler_wait_arg(&group->waiters, timeout, &wait)) {
+      matched = event_check(group, &wait);
+      break;
+    }
+  }
+
+  mv_scheduler_unlock();
+  return matched;
+}
+
+U32 mv_event_group_set(mv_event_group_t *group, U32 flags) {
+  U32 result;
+
+  nx_interrupts_disable();
+  group->flags |= flags;
+  result = group->flags;
+  nx_interrupts_enable();
+
+  /* Interrupt handlers may not touch the scheduler state, so the
+   * wakeup is always posted. The scheduler then wakes up the matching
+   * waiters as soon as it can. The waiters are not checked here, as a
+   * task may be about to block.
+   */
+  mv__scheduler_wake_isr(&group->waiters);
+
+  return result;
+}
+
+U32 mv_event_group_clear(mv_event_group_t *group, U32 flags) {
+  U32 result;
+
+  nx_interrupts_disable();
+  result = group->flags;
+  group->flags &= ~flags;
+  nx_interrupts_enable();
+
+  return result;
+}
+
+U32 mv_event_group_get(mv_event_group_t *group) {
+  return group->flags;
+}
+
+void mv_event_group_destroy(mv_event_group_t *group) {
+  mv_scheduler_lock();
+  NX_ASSERT(mv_list_is_empty(group->waiters.waiters));
+
+  /* A wakeup still posted by an interrupt handler would leave the
+   * freed group in the scheduler's post queue.
+   */
+  nx_interrupts_disable();
+  NX_ASSERT(!group->waiters.post.posted);
+  nx_interrupts_enable();
+
+  nx_free(group);
+  mv_scheduler_unlock();
+}
@@ -0,0 +1,102 @@
+/** @file event.h
+ *  @brief Marvin's event flag groups.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_EVENT_H__
+#define __NXOS_MARVIN_EVENT_H__
+
+#include "base/types.h"
+#include "marvin/scheduler.h"
+
+/** A group of 32 event flags that tasks can wait on.
+ *
+ * Each event source, be it a task or an interrupt handler, sets its own
+ * flags. A task can then wait for any or all of several flags at once,
+ * instead of blocking on one semaphore per source.
+ */
+typedef struct mv_event_group mv_event_group_t;
+
+/** Options for mv_event_group_wait(), to be or'ed together. */
+enum {
+  MV_EVENT_WAIT_ANY = 0, /**< Wait for any of the flags to be set. */
+  MV_EVENT_WAIT_ALL = 1, /**< Wait for all the flags to be set. */
+  MV_EVENT_CLEAR = 2, /**< Clear the awaited flags once the wait is
+                         over, so that they are consumed by the
+                         waiting task. */
+};
+
+/** Create and return a new event group, with all flags cleared.
+ *
+ * @return A new event group.
+ */
+mv_event_group_t *mv_event_group_create(void);
+
+/** Wait for flags of @a group to be set, for at most @a timeout
+ * milliseconds.
+ *
+ * @param group The event group to wait on.
+ * @param flags The flags to wait for. May not be zero.
+ * @param options MV_EVENT_WAIT_ANY or MV_EVENT_WAIT_ALL, optionally
+ * or'ed with MV_EVENT_CLEAR.
+ * @param timeout The maximum time to wait, in milliseconds, or
+ * MV_TIMEOUT_INFINITE. With a zero timeout, the flags are only checked.
+ * @return The awaited flags that were set when the wait ended, or 0 on
+ * timeout.
+ *
+ * @note With MV_EVENT_CLEAR, the flags are checked and cleared
+ * atomically, so that each occurence of the events is consumed by only
+ * one task.
+ */
+U32 mv_event_group_wait(mv_event_group_t *group, U32 flags, U32 options,
+                        U32 timeout);
+
+/** Set @a flags in @a group, waking up the tasks whose wait they
+ * satisfy.
+ *
+ * All the matching waiters are woken up at once, in a single pass over
+ * the waiting tasks.
+ *
+ * @param group The event group to update.
+ * @param flags The flags to set.
+ * @return The flags of @a group, after setting @a flags.
+ *
+ * @note This may be called from interrupt handlers as well as tasks.
+ */
+U32 mv_event_group_set(mv_event_group_t *group, U32 flags);
+
+/** Clear @a flags in @a group.
+ *
+ * @param group The event group to update.
+ * @param flags The flags to clear.
+ * @return The flags of @a group, before clearing @a flags.
+ *
+ * @note This may be called from interrupt handlers as well as tasks.
+ */
+U32 mv_event_group_clear(mv_event_group_t *group, U32 flags);
+
+/** Return the flags of @a group.
+ *
+ * @param group The event group to query.
+ * @return The flags currently set in @a group.
+ */
+U32 mv_event_group_get(mv_event_group_t *group);
+
+/** Destroy @a group and free any memory it uses.
+ *
+ * @param group The event group to destroy.
+ *
+ * @warning Destroying an event group while tasks are blocked on it,
+ * or while the wakeup of an interrupt handler setting it is pending,
+ * will cause Marvin to assert and crash.
+ */
+void mv_event_group_destroy(mv_event_group_t *group);
+
+#endif /* __NXOS_MARVIN_EVENT_H__ */
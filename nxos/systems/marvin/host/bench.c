@@ -0,0 +1,632 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+/* Scheduler test and benchmark for the host port. Runs a few thousand
+ * tasks exercising sleeps, semaphores, message queues fed by interrupt
+ * handlers, event groups, driver completions, timeouts and joins,
+ * periodic and real-time tasks, lightweight tasks, and CPU-bound
+ * preemption and throttling, with event tracing on for a while. It
+ * checks the outcome, and reports scheduling statistics and host time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "base/types.h"
+#include "base/completion.h"
+#include "base/drivers/systick.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/_scheduler.h"
+#include "marvin/semaphore.h"
+#include "marvin/queue.h"
+#include "marvin/event.h"
+#include "marvin/time.h"
+#include "marvin/pt.h"
+#include "marvin/trace.h"
+#include "marvin/host/host.h"
+
+#define SLEEPERS 2000
+#define SLEEPS 20
+#define PINGPONGS 10000
+#define CRUNCHERS 4
+#define CRUNCH_MS 1000
+#define THROTTLED_MS 100
+#define BUDGET 1
+#define BUDGET_PERIOD 10
+#define IRQ_MESSAGES 1000
+#define IO_REQUESTS 500
+#define IO_TIMEOUT 50
+#define JOIN_WORK_MS 30
+#define JOIN_TIMEOUT 10
+#define TRACE_EVENTS 1024
+#define EVENT_ROUNDS 200
+#define EVENT_IRQ 0x1
+#define EVENT_TASK 0x2
+#define EVENT_NEVER 0x4
+#define EVENT_TIMEOUT 10
+#define TRACE_MS 100
+#define PERIOD 50
+#define PERIODIC_JOBS 50
+#define OVERRUN_PERIOD 100
+#define OVERRUN_JOBS 5
+#define OVERRUN_MS 250
+#define OVERRUN_MISSES 2
+#define RT_TASKS 3
+#define RT_RUN_MS 400
+#define PT_TASKS 4
+#define PT_STEPS 50
+#define PT_LATE_STEPS 10
+
+static U32 sleeps_done = 0;
+static U32 sleeps_early = 0;
+static U32 sleep_lateness_max = 0;
+
+static mv_sem_t *ping, *pong;
+static U32 pings = 0, pongs = 0;
+
+static U32 crunchers_done = 0;
+static U32 throttled_elapsed = 0, throttled_count = 0;
+
+static mv_queue_t *irq_queue;
+static U32 irq_sent = 0, irq_dropped = 0, irq_received = 0;
+static bool irq_in_order = TRUE;
+
+static nx_completion_t io_done;
+static U32 io_requests = 0, io_completed = 0, io_waited = 0;
+static bool io_timeout_ok = FALSE;
+
+static mv_event_group_t *events;
+static U32 event_rounds = 0, event_waits = 0;
+static bool event_timeout_ok = FALSE;
+
+static mv_sem_t *never_sem;
+static bool join_ok = FALSE, sem_timeout_ok = FALSE;
+
+static U32 trace_bytes = 0, trace_events = 0, trace_lost = 0;
+static bool trace_ordered = TRUE;
+
+static U32 periodic_jobs = 0, periodic_misses = 0, periodic_first = 0;
+static bool periodic_on_time = TRUE;
+static U32 overrun_jobs = 0, overrun_misses = 0;
+
+/* Real-time tasks whose densities add up to exactly 1. */
+static struct {
+  U32 period, deadline, wcet;
+  U32 jobs, misses;
+} rt_tasks[RT_TASKS] = {
+  { 10, 10, 5, 0, 0 },
+  { 20, 20, 5, 0, 0 },
+  { 50, 40, 10, 0, 0 },
+};
+static U32 rt_admitted = 0, rt_rejected = 0;
+static U32 rt_last_release = 0, rt_last_deadline = 0;
+static bool rt_in_order = TRUE;
+
+/* Lightweight tasks, and one spawned once the others are done. */
+static struct pt_state {
+  U32 id;
+  U32 steps;
+  U32 ticks_seen;
+} pt_states[PT_TASKS];
+static mv_pt_t pts[PT_TASKS], pt_late;
+static U32 pt_ticks = 0, pt_done = 0;
+static U32 pt_late_steps = 0, pt_spawn_time = 0, pt_spawn_latency = 0;
+
+/* Sleep for various durations, checking the wakeup times. */
+static void sleeper(void) {
+  static U32 id = 0;
+  U32 duration = (id++ % 50) + 1;
+  U32 i, start, late;
+
+  for (i = 0; i < SLEEPS; i++) {
+    start = nx_systick_get_ms();
+    mv_time_sleep(duration);
+    if (nx_systick_get_ms() < start + duration) {
+      sleeps_early++;
+    } else {
+      late = nx_systick_get_ms() - start - duration;
+      if (late > sleep_lateness_max)
+        sleep_lateness_max = late;
+    }
+    sleeps_done++;
+  }
+}
+
+static void pinger(void) {
+  U32 i;
+
+  for (i = 0; i < PINGPONGS; i++) {
+    mv_semaphore_inc(ping);
+    mv_semaphore_dec(pong);
+    pings++;
+  }
+}
+
+static void ponger(void) {
+  U32 i;
+
+  for (i = 0; i < PINGPONGS; i++) {
+    mv_semaphore_dec(ping);
+    pongs++;
+    mv_semaphore_inc(pong);
+  }
+}
+
+/* CPU-bound task, which only gets off the CPU by preemption. */
+static void cruncher(void) {
+  mv_host_consume(CRUNCH_MS);
+  crunchers_done++;
+}
+
+/* CPU-bound task on a budget, which takes BUDGET_PERIOD / BUDGET times
+ * longer than its CPU time to complete.
+ */
+static void throttled(void) {
+  mv_task_t *self = mv_scheduler_get_current_task();
+  mv_task_stats_t stats;
+  U32 start = nx_systick_get_ms();
+
+  mv_scheduler_set_budget(self, BUDGET, BUDGET_PERIOD);
+  mv_host_consume(THROTTLED_MS);
+  throttled_elapsed = nx_systick_get_ms() - start;
+  mv_scheduler_get_task_stats(self, &stats);
+  throttled_count = stats.throttles;
+}
+
+/* Interrupt handler sending messages to a task. */
+static void irq_handler(void) {
+  U32 *msg = mv_queue_isr_alloc(irq_queue);
+
+  if (msg == NULL) {
+    irq_dropped++;
+    return;
+  }
+  *msg = irq_sent++;
+  mv_queue_isr_send(irq_queue, msg);
+}
+
+/* Raise the interrupt every millisecond, as a device would. */
+static void irq_source(void) {
+  U32 i;
+
+  for (i = 0; i < IRQ_MESSAGES; i++) {
+    mv_host_consume(1);
+    mv_host_interrupt(irq_handler);
+  }
+}
+
+static void irq_consumer(void) {
+  U32 *msg;
+
+  while ((msg = mv_queue_receive(irq_queue, 100)) != NULL) {
+    if (*msg != irq_received)
+      irq_in_order = FALSE;
+    irq_received++;
+    mv_queue_free(irq_queue, msg);
+  }
+}
+
+/* Interrupt handler completing an I/O request. */
+static void io_handler(void) {
+  io_completed++;
+  nx_completion_signal(&io_done);
+}
+
+/* A device taking a couple of milliseconds to serve each request. */
+static void io_device(void) {
+  while (io_completed < IO_REQUESTS) {
+    mv_time_sleep(2);
+    if (io_requests > io_completed)
+      mv_host_interrupt(io_handler);
+  }
+}
+
+/* A driver user, blocking on each request. */
+static void io_user(void) {
+  nx_completion_t never;
+  U32 start;
+
+  while (io_waited < IO_REQUESTS) {
+    nx_completion_init(&io_done);
+    io_requests++;
+    nx_completion_wait(&io_done, NX_COMPLETION_WAIT_FOREVER);
+    io_waited++;
+  }
+
+  nx_completion_init(&never);
+  start = nx_systick_get_ms();
+  io_timeout_ok = (!nx_completion_wait(&never, IO_TIMEOUT) &&
+                   nx_systick_get_ms() - start >= IO_TIMEOUT);
+}
+
+static void event_irq(void) {
+  mv_event_group_set(events, EVENT_IRQ);
+}
+
+/* Set one flag from an interrupt handler and one from a task, every
+ * millisecond.
+ */
+static void event_source(void) {
+  for (event_rounds = 0; event_rounds < EVENT_ROUNDS; event_rounds++) {
+    mv_time_sleep(1);
+    mv_host_interrupt(event_irq);
+    mv_event_group_set(events, EVENT_TASK);
+  }
+}
+
+/* Wait for both flags until they stop coming, then time out on a flag
+ * that is never set.
+ */
+static void event_waiter(void) {
+  U32 start;
+
+  while (mv_event_group_wait(events, EVENT_IRQ | EVENT_TASK,
+                             MV_EVENT_WAIT_ALL | MV_EVENT_CLEAR, 100) ==
+         (EVENT_IRQ | EVENT_TASK))
+    event_waits++;
+
+  start = nx_systick_get_ms();
+  event_timeout_ok = (mv_event_group_wait(events, EVENT_NEVER,
+                                          MV_EVENT_WAIT_ANY,
+                                          EVENT_TIMEOUT) == 0 &&
+                      nx_systick_get_ms() - start >= EVENT_TIMEOUT);
+}
+
+static void join_worker(void) {
+  mv_host_consume(JOIN_WORK_MS);
+}
+
+/* Join a worker, giving up once before it is done, and time out on a
+ * semaphore that is never incremented.
+ */
+static void joiner(void) {
+  mv_task_t *worker = mv_scheduler_create_joinable_task(join_worker, 256);
+  U32 start = nx_systick_get_ms();
+
+  join_ok = (!mv_task_join(worker, JOIN_TIMEOUT) &&
+             nx_systick_get_ms() - start >= JOIN_TIMEOUT &&
+             mv_task_join(worker, MV_TIMEOUT_INFINITE) &&
+             nx_systick_get_ms() - start >= JOIN_WORK_MS);
+
+  start = nx_systick_get_ms();
+  sem_timeout_ok = (!mv_semaphore_dec_timeout(never_sem, JOIN_TIMEOUT) &&
+                    nx_systick_get_ms() - start >= JOIN_TIMEOUT);
+}
+
+/* A periodic job, checking that it is released on its own multiple of
+ * the period, however late the previous jobs ran.
+ */
+static void periodic_job(void) {
+  U32 now = nx_systick_get_ms();
+
+  if (periodic_jobs == 0)
+    periodic_first = now - now % PERIOD;
+  if (now - now % PERIOD != periodic_first + periodic_jobs * PERIOD)
+    periodic_on_time = FALSE;
+  mv_host_consume(1);
+
+  if (++periodic_jobs == PERIODIC_JOBS) {
+    periodic_misses =
+      mv_scheduler_get_deadline_misses(mv_scheduler_get_current_task());
+    mv_task_exit();
+  }
+}
+
+/* A periodic job, the first of which runs over the next two
+ * releases.
+ */
+static void overrun_job(void) {
+  mv_time_sleep(overrun_jobs == 0 ? OVERRUN_MS : 1);
+
+  if (++overrun_jobs == OVERRUN_JOBS) {
+    overrun_misses =
+      mv_scheduler_get_deadline_misses(mv_scheduler_get_current_task());
+    mv_task_exit();
+  }
+}
+
+/* A real-time job, checking that jobs released together run by
+ * deadline.
+ */
+static void rt_job(U32 i) {
+  U32 now = nx_systick_get_ms();
+  U32 release = now - now % rt_tasks[i].period;
+
+  if (release == rt_last_release &&
+      release + rt_tasks[i].deadline < rt_last_deadline)
+    rt_in_order = FALSE;
+  rt_last_release = release;
+  rt_last_deadline = release + rt_tasks[i].deadline;
+  mv_host_consume(1);
+
+  if (++rt_tasks[i].jobs == RT_RUN_MS / rt_tasks[i].period) {
+    rt_tasks[i].misses =
+      mv_scheduler_get_deadline_misses(mv_scheduler_get_current_task());
+    mv_task_exit();
+  }
+}
+
+static void rt_job0(void) {
+  rt_job(0);
+}
+
+static void rt_job1(void) {
+  rt_job(1);
+}
+
+static void rt_job2(void) {
+  rt_job(2);
+}
+
+/* A lightweight task, which sleeps and then waits for the next tick of
+ * a regular task at each step.
+ */
+static mv_pt_status_t pt_worker(mv_pt_t *pt) {
+  struct pt_state *s = pt->data;
+
+  MV_PT_BEGIN(pt);
+  while (s->steps < PT_STEPS) {
+    MV_PT_SLEEP(pt, s->id + 1);
+    MV_PT_WAIT_UNTIL(pt, pt_ticks != s->ticks_seen);
+    s->ticks_seen = pt_ticks;
+    s->steps++;
+  }
+  pt_done++;
+  MV_PT_END(pt);
+}
+
+/* A lightweight task spawned while the carrier waits for good. As the
+ * carrier never returns, this task ends it, so that the bench can
+ * terminate.
+ */
+static mv_pt_status_t pt_late_worker(mv_pt_t *pt) {
+  MV_PT_BEGIN(pt);
+  pt_spawn_latency = nx_systick_get_ms() - pt_spawn_time;
+  while (pt_late_steps < PT_LATE_STEPS) {
+    pt_late_steps++;
+    MV_PT_YIELD(pt);
+    MV_PT_SLEEP(pt, 1);
+  }
+  mv_task_exit();
+  MV_PT_END(pt);
+}
+
+/* Tick for the lightweight tasks until they are done, then spawn
+ * another one.
+ */
+static void pt_ticker(void) {
+  while (pt_done < PT_TASKS) {
+    mv_time_sleep(1);
+    pt_ticks++;
+  }
+
+  mv_time_sleep(10);
+  pt_spawn_time = nx_systick_get_ms();
+  mv_pt_spawn(&pt_late, pt_late_worker, NULL);
+}
+
+/* Check the trace dump as the USB host would receive it. */
+static void trace_sink(U8 *data, U32 length) {
+  mv_trace_event_t *e;
+  U32 i;
+
+  /* The first write is the dump size. */
+  if (trace_bytes == 0) {
+    trace_bytes = *(U32*)data;
+    return;
+  }
+
+  trace_events = ((U32*)data)[0];
+  trace_lost = ((U32*)data)[1];
+  e = (mv_trace_event_t*)((U32*)data + 2);
+  if (length != 2 * sizeof(U32) + trace_events * sizeof(*e))
+    trace_ordered = FALSE;
+  for (i = 1; i < trace_events; i++) {
+    if (e[i].time < e[i-1].time)
+      trace_ordered = FALSE;
+  }
+}
+
+static void tracer(void) {
+  mv_trace_start(TRACE_EVENTS);
+  mv_time_sleep(TRACE_MS);
+  mv_trace_stop();
+
+  mv_host_set_usb_sink(trace_sink);
+  mv_trace_dump();
+  mv_host_set_usb_sink(NULL);
+  mv_trace_free();
+}
+
+int main(void) {
+  mv_scheduler_stats_t stats;
+  clock_t start;
+  double host_s;
+  bool ok = TRUE;
+  U32 i;
+
+  nx_memalloc_init();
+  mv__scheduler_init();
+
+  ping = mv_semaphore_create(0);
+  pong = mv_semaphore_create(0);
+  never_sem = mv_semaphore_create(0);
+  events = mv_event_group_create();
+  irq_queue = mv_queue_create(4, sizeof(U32));
+
+  for (i = 0; i < SLEEPERS; i++)
+    mv_scheduler_create_task(sleeper, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(pinger, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(ponger, 256, MV_QUANTUM_DEFAULT);
+  for (i = 0; i < CRUNCHERS; i++)
+    mv_scheduler_create_task(cruncher, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(throttled, 256, 1);
+  mv_scheduler_create_task(irq_source, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(irq_consumer, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(io_device, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(io_user, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(event_source, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(event_waiter, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(joiner, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(tracer, 256, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_periodic_task(periodic_job, PERIOD, 256);
+  mv_scheduler_create_periodic_task(overrun_job, OVERRUN_PERIOD, 256);
+
+  /* The real-time tasks fill the CPU, so that any other one is
+   * rejected: one that does not fit, one that runs longer than its
+   * period, and one with a density too small to be seen, but rounded
+   * up.
+   */
+  rt_admitted += !!mv_scheduler_create_rt_task(rt_job0, 10, 10, 5, 256);
+  rt_admitted += !!mv_scheduler_create_rt_task(rt_job1, 20, 20, 5, 256);
+  rt_admitted += !!mv_scheduler_create_rt_task(rt_job2, 50, 40, 10, 256);
+  rt_rejected += !mv_scheduler_create_rt_task(rt_job0, 10, 10, 1, 256);
+  rt_rejected += !mv_scheduler_create_rt_task(rt_job0, 10, 20, 15, 256);
+  rt_rejected += !mv_scheduler_create_rt_task(rt_job0, 0xF0000000,
+                                              0xF0000000, 0xFFFF, 256);
+
+  mv_pt_init(256);
+  for (i = 0; i < PT_TASKS; i++) {
+    pt_states[i].id = i;
+    mv_pt_spawn(&pts[i], pt_worker, &pt_states[i]);
+  }
+  mv_scheduler_create_task(pt_ticker, 256, MV_QUANTUM_DEFAULT);
+
+  start = clock();
+  mv__scheduler_run();
+  host_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  mv_scheduler_get_stats(&stats);
+
+  printf("Virtual time: %lu ms, host time: %.3f s\n",
+         nx_systick_get_ms(), host_s);
+  printf("Context switches: %lu (%.0f per host second)\n",
+         stats.context_switches, stats.context_switches / host_s);
+  printf("Wakeups: %lu, worst latency: %lu ms\n",
+         stats.wakeups, stats.latency_max);
+  for (i = 0; i < MV_LATENCY_BUCKETS; i++)
+    printf("  latency bucket %lu: %lu\n", i, stats.latency[i]);
+  printf("Sleeps: %lu, worst lateness: %lu ms\n",
+         sleeps_done, sleep_lateness_max);
+  printf("Interrupt messages: %lu received, %lu dropped\n",
+         irq_received, irq_dropped);
+  printf("Throttled task: %lu ms to run %d ms, throttled %lu times\n",
+         throttled_elapsed, THROTTLED_MS, throttled_count);
+  printf("Event groups: %lu rounds, %lu waits satisfied\n",
+         event_rounds, event_waits);
+  printf("Trace: %lu events dumped, %lu lost\n", trace_events, trace_lost);
+  printf("Periodic tasks: %lu jobs, %lu misses, overrun %lu jobs, "
+         "%lu misses\n", periodic_jobs, periodic_misses, overrun_jobs,
+         overrun_misses);
+  printf("Real-time tasks: %lu admitted, %lu rejected, jobs %lu/%lu/%lu, "
+         "misses %lu/%lu/%lu\n", rt_admitted, rt_rejected,
+         rt_tasks[0].jobs, rt_tasks[1].jobs, rt_tasks[2].jobs,
+         rt_tasks[0].misses, rt_tasks[1].misses, rt_tasks[2].misses);
+  printf("Lightweight tasks: %lu done, late one ran %lu steps after %lu ms\n",
+         pt_done, pt_late_steps, pt_spawn_latency);
+
+  if (sleeps_done != SLEEPERS * SLEEPS || sleeps_early != 0) {
+    printf("FAIL: %lu sleeps done, %lu woke up early\n",
+           sleeps_done, sleeps_early);
+    ok = FALSE;
+  }
+  if (pings != PINGPONGS || pongs != PINGPONGS) {
+    printf("FAIL: %lu pings, %lu pongs\n", pings, pongs);
+    ok = FALSE;
+  }
+  if (crunchers_done != CRUNCHERS ||
+      nx_systick_get_ms() < CRUNCHERS * CRUNCH_MS) {
+    printf("FAIL: %lu crunchers done\n", crunchers_done);
+    ok = FALSE;
+  }
+
+  if (throttled_count < THROTTLED_MS / BUDGET - 1 ||
+      throttled_elapsed < (THROTTLED_MS / BUDGET - 1) * BUDGET_PERIOD) {
+    printf("FAIL: throttled task took %lu ms, throttled %lu times\n",
+           throttled_elapsed, throttled_count);
+    ok = FALSE;
+  }
+
+  if (irq_sent + irq_dropped != IRQ_MESSAGES ||
+      irq_received != irq_sent || !irq_in_order) {
+    printf("FAIL: %lu interrupt messages sent, %lu dropped, %lu received\n",
+           irq_sent, irq_dropped, irq_received);
+    ok = FALSE;
+  }
+
+  if (io_waited != IO_REQUESTS || io_completed != IO_REQUESTS ||
+      !io_timeout_ok) {
+    printf("FAIL: %lu I/O requests completed, %lu waited for\n",
+           io_completed, io_waited);
+    ok = FALSE;
+  }
+
+  if (trace_events != TRACE_EVENTS || !trace_ordered) {
+    printf("FAIL: %lu trace events dumped, %s\n", trace_events,
+           trace_ordered ? "in order" : "out of order");
+    ok = FALSE;
+  }
+
+  if (event_rounds != EVENT_ROUNDS || event_waits == 0 ||
+      event_waits > EVENT_ROUNDS || !event_timeout_ok) {
+    printf("FAIL: %lu event rounds, %lu waits satisfied, timeout %s\n",
+           event_rounds, event_waits, event_timeout_ok ? "ok" : "failed");
+    ok = FALSE;
+  }
+
+  if (!join_ok || !sem_timeout_ok) {
+    printf("FAIL: join %s, semaphore timeout %s\n",
+           join_ok ? "ok" : "failed", sem_timeout_ok ? "ok" : "failed");
+    ok = FALSE;
+  }
+
+  if (periodic_jobs != PERIODIC_JOBS || periodic_misses != 0 ||
+      !periodic_on_time) {
+    printf("FAIL: %lu periodic jobs, %lu misses, %s\n", periodic_jobs,
+           periodic_misses, periodic_on_time ? "on time" : "drifting");
+    ok = FALSE;
+  }
+
+  if (overrun_jobs != OVERRUN_JOBS || overrun_misses != OVERRUN_MISSES) {
+    printf("FAIL: %lu overrunning jobs, %lu misses\n", overrun_jobs,
+           overrun_misses);
+    ok = FALSE;
+  }
+
+  if (rt_admitted != RT_TASKS || rt_rejected != 3 || !rt_in_order) {
+    printf("FAIL: %lu real-time tasks admitted, %lu rejected, %s\n",
+           rt_admitted, rt_rejected, rt_in_order ? "in order" : "out of order");
+    ok = FALSE;
+  }
+  for (i = 0; i < RT_TASKS; i++) {
+    if (rt_tasks[i].jobs != RT_RUN_MS / rt_tasks[i].period ||
+        rt_tasks[i].misses != 0) {
+      printf("FAIL: real-time task %lu ran %lu jobs, missed %lu\n", i,
+             rt_tasks[i].jobs, rt_tasks[i].misses);
+      ok = FALSE;
+    }
+  }
+
+  for (i = 0; i < PT_TASKS; i++) {
+    if (pt_states[i].steps != PT_STEPS) {
+      printf("FAIL: lightweight task %lu ran %lu steps\n", i,
+             pt_states[i].steps);
+      ok = FALSE;
+    }
+  }
+  if (pt_done != PT_TASKS || pt_late_steps != PT_LATE_STEPS) {
+    printf("FAIL: %lu lightweight tasks done, late one ran %lu steps\n",
+           pt_done, pt_late_steps);
+    ok = FALSE;
+  }
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,323 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+/* Host port of the parts of the baseplate that Marvin uses, and of the
+ * task switching primitives of task.S.
+ *
+ * On the brick, the scheduler runs in an interrupt handler, reads the
+ * stack pointer of the interrupted task with mv__task_get_stack(), and
+ * replaces it with mv__task_set_stack() to resume another task on
+ * return from interrupt. Here, each task is a ucontext with a stack of
+ * its own, and the "stack pointer" handed to the scheduler is really a
+ * pointer to the task's context. The first time the scheduler switches
+ * to a new task, the pointer is that of the register frame built by
+ * new_task(), and the context is created from the pc and lr it holds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/core.h"
+#include "base/interrupts.h"
+#include "base/lock.h"
+#include "base/_defer.h"
+#include "base/drivers/avr.h"
+#include "base/drivers/usb.h"
+#include "base/drivers/_systick.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/_task.h"
+#include "marvin/host/host.h"
+
+/* Marks task contexts, as opposed to new task register frames. */
+#define CTX_MAGIC 0x4D56484F
+
+/* The host stack of each task. Task stacks on the brick are far too
+ * small for host code.
+ */
+#define CTX_STACK_SIZE (32 * 1024)
+
+struct host_ctx {
+  U32 magic;
+  ucontext_t uc;
+  nx_closure_t func; /* The task function. */
+  nx_closure_t shutdown; /* Called when the task function returns. */
+  bool dead; /* Set once the task is shutting down. */
+  void *stack;
+};
+
+static struct host_ctx *ctx_current; /* The running task. */
+static struct host_ctx *ctx_next; /* The task selected by the scheduler. */
+static struct host_ctx *ctx_idle; /* The task started by mv__task_run_first. */
+static struct host_ctx *ctx_zombie; /* A dead task, to free. */
+
+/* Where mv__task_run_first() returns to. */
+static ucontext_t host_main;
+
+/* Simulated interrupt state. */
+static U32 irq_disabled = 0;
+static bool irq_pending = FALSE;
+static bool irq_running = FALSE;
+
+/* Simulated system timer. */
+static U32 systick_time = 0;
+static nx_closure_t scheduler_cb = NULL;
+static bool scheduler_inhibit = FALSE;
+
+static void (*usb_sink)(U8 *data, U32 length) = NULL;
+
+/*
+ * Task contexts.
+ */
+
+static void ctx_reap(void) {
+  if (ctx_zombie != NULL) {
+    free(ctx_zombie->stack);
+    free(ctx_zombie);
+    ctx_zombie = NULL;
+  }
+}
+
+static void ctx_entry(void) {
+  ctx_reap();
+  ctx_current->func();
+
+  /* Returning from the task function on the brick lands in the
+   * shutdown stub set up as lr, which never returns.
+   */
+  ctx_current->dead = TRUE;
+  ctx_current->shutdown();
+  NX_FAIL("Dead task\nresumed");
+}
+
+static struct host_ctx *ctx_create(nx_closure_t func, nx_closure_t shutdown) {
+  struct host_ctx *ctx = nx_calloc(1, sizeof(*ctx));
+
+  ctx->magic = CTX_MAGIC;
+  ctx->func = func;
+  ctx->shutdown = shutdown;
+  ctx->stack = nx_malloc(CTX_STACK_SIZE);
+
+  getcontext(&ctx->uc);
+  ctx->uc.uc_stack.ss_sp = ctx->stack;
+  ctx->uc.uc_stack.ss_size = CTX_STACK_SIZE;
+  ctx->uc.uc_link = NULL;
+  makecontext(&ctx->uc, ctx_entry, 0);
+
+  return ctx;
+}
+
+static void ctx_switch(struct host_ctx *next) {
+  struct host_ctx *prev = ctx_current;
+
+  ctx_current = next;
+  if (prev->dead) {
+    ctx_zombie = prev;
+    setcontext(&next->uc);
+  }
+  swapcontext(&prev->uc, &next->uc);
+  ctx_reap();
+}
+
+void mv__task_run_first(nx_closure_t func, U32 *stack __attribute__((unused))) {
+  ctx_idle = ctx_create(func, NULL);
+  ctx_current = ctx_idle;
+  swapcontext(&host_main, &ctx_idle->uc);
+}
+
+U32 *mv__task_get_stack(void) {
+  return (U32*)ctx_current;
+}
+
+bool mv__task_in_task_mode(void) {
+  return irq_disabled == 0 && !irq_running;
+}
+
+void mv__task_set_stack(U32 *stack) {
+  struct host_ctx *ctx = (struct host_ctx*)stack;
+
+  if (ctx->magic != CTX_MAGIC) {
+    nx_task_stack_t *s = (nx_task_stack_t*)stack;
+    ctx = ctx_create((nx_closure_t)s->pc, (nx_closure_t)s->lr);
+  }
+
+  ctx_next = ctx;
+}
+
+/*
+ * Interrupts and system timer.
+ */
+
+/* The low priority system interrupt: deferred work, then scheduler. */
+static void host_irq(void) {
+  if (irq_disabled > 0 || irq_running) {
+    irq_pending = TRUE;
+    return;
+  }
+
+  do {
+    irq_pending = FALSE;
+    irq_running = TRUE;
+    ctx_next = ctx_current;
+    nx__defer_irq();
+    if (scheduler_cb)
+      scheduler_cb();
+    irq_running = FALSE;
+
+    if (ctx_next != ctx_current)
+      ctx_switch(ctx_next);
+  } while (irq_pending && irq_disabled == 0);
+}
+
+static void host_tick(void) {
+  systick_time++;
+  if (!scheduler_inhibit && scheduler_cb)
+    host_irq();
+}
+
+U32 nx_atomic_cas32(U32 *dest, U32 val) {
+  return __atomic_exchange_n(dest, val, __ATOMIC_SEQ_CST);
+}
+
+U8 nx_atomic_cas8(U8 *dest, U8 val) {
+  return __atomic_exchange_n(dest, val, __ATOMIC_SEQ_CST);
+}
+
+void nx_interrupts_disable(void) {
+  irq_disabled++;
+}
+
+void nx_interrupts_enable(void) {
+  if (irq_disabled > 0 && --irq_disabled == 0 && irq_pending)
+    host_irq();
+}
+
+U32 nx_systick_get_ms(void) {
+  return systick_time;
+}
+
+/* The host time only moves by whole milliseconds. */
+U32 nx_systick_get_us(void) {
+  return systick_time * 1000;
+}
+
+void nx_systick_wait_ms(U32 ms) {
+  mv_host_consume(ms);
+}
+
+void nx_systick_wait_us(U32 us __attribute__((unused))) {
+}
+
+void nx_systick_wait_ns(U32 ns __attribute__((unused))) {
+}
+
+void nx_systick_install_scheduler(nx_closure_t sched_cb) {
+  scheduler_cb = sched_cb;
+}
+
+void nx_systick_call_scheduler(void) {
+  if (!scheduler_cb)
+    return;
+
+  host_irq();
+
+  /* The idle task spins on the scheduler until a task wakes up, which
+   * takes time.
+   */
+  if (ctx_current == ctx_idle && irq_disabled == 0)
+    host_tick();
+}
+
+void nx_systick_mask_scheduler(void) {
+  scheduler_inhibit = TRUE;
+}
+
+void nx_systick_unmask_scheduler(void) {
+  scheduler_inhibit = FALSE;
+}
+
+void nx__systick_trigger_sysirq(void) {
+  host_irq();
+}
+
+void mv_host_consume(U32 ms) {
+  while (ms--)
+    host_tick();
+}
+
+void mv_host_interrupt(nx_closure_t isr) {
+  nx_interrupts_disable();
+  isr();
+  nx_interrupts_enable();
+}
+
+/*
+ * Other baseplate services.
+ */
+
+void nx_assert_error(const char *file, const int line,
+                     const char *expr, const char *msg) {
+  /* The idle task fails once all the tasks are dead, which is how the
+   * scheduler returns on the host.
+   */
+  if (ctx_current == ctx_idle && msg[0] == '\0') {
+    setcontext(&host_main);
+  }
+
+  fprintf(stderr, "%s:%d: %s: %s\n", file, line, expr, msg);
+  abort();
+}
+
+void nx_core_halt(void) {
+  exit(0);
+}
+
+nx_avr_button_t nx_avr_get_button(void) {
+  return BUTTON_NONE;
+}
+
+void nx_memalloc_init(void) {
+}
+
+void *nx_malloc(U32 size) {
+  void *ptr = malloc(size);
+  NX_ASSERT_MSG(ptr != NULL, "Out of memory");
+  return ptr;
+}
+
+void *nx_calloc(U32 nelem, U32 elem_size) {
+  void *ptr = calloc(nelem, elem_size);
+  NX_ASSERT_MSG(ptr != NULL, "Out of memory");
+  return ptr;
+}
+
+void *nx_realloc(void *ptr, U32 size) {
+  ptr = realloc(ptr, size);
+  NX_ASSERT_MSG(ptr != NULL, "Out of memory");
+  return ptr;
+}
+
+void nx_free(void *ptr) {
+  free(ptr);
+}
+
+void nx_usb_write(U8 *data, U32 length) {
+  if (usb_sink)
+    usb_sink(data, length);
+}
+
+bool nx_usb_data_written(void) {
+  return TRUE;
+}
+
+void mv_host_set_usb_sink(void (*sink)(U8 *data, U32 length)) {
+  usb_sink = sink;
+}
@@ -0,0 +1,61 @@
+/** @file host.h
+ *  @brief Host-side controls of Marvin's host port.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_HOST_HOST_H__
+#define __NXOS_MARVIN_HOST_HOST_H__
+
+#include "base/types.h"
+
+/** @defgroup marvinhost Marvin host port
+ *
+ * The host port runs Marvin as a regular Linux process, for testing
+ * and benchmarking. Tasks are ucontext coroutines, and the system timer
+ * is simulated in virtual time.
+ *
+ * Virtual time is deterministic: it only flows when a task declares
+ * that it computes with mv_host_consume(), and while the idle task
+ * runs. Sleeps, timeouts and quanta are thus exactly reproducible from
+ * one run to the next, however fast the host is.
+ *
+ * The scheduler returns from mv__scheduler_run() once all the tasks
+ * are dead.
+ */
+/*@{*/
+
+/** Compute for @a ms milliseconds of virtual time in the calling task.
+ *
+ * This is the host equivalent of a busy loop: system timer interrupts
+ * keep firing, so the task may be preempted in the middle.
+ *
+ * @param ms The virtual CPU time to consume.
+ */
+void mv_host_consume(U32 ms);
+
+/** Run @a isr as a device driver interrupt handler.
+ *
+ * The scheduler does not run until the handler returns, as on the brick
+ * where driver interrupts are serviced before returning to the tasks.
+ *
+ * @param isr The interrupt handler to run.
+ */
+void mv_host_interrupt(nx_closure_t isr);
+
+/** Set the function receiving the data written to USB.
+ *
+ * @param sink The function called by nx_usb_write(), or NULL to discard
+ * the data.
+ */
+void mv_host_set_usb_sink(void (*sink)(U8 *data, U32 length));
+
+/*@}*/
+
+#endif /* __NXOS_MARVIN_HOST_HOST_H__ */
@@ -74,7 +74,7 @@
 /** Insert @a item at the tail of @a list */
 #define mv_list_add_tail(list, item) ({ \
   if (list) \
-    mv_list_insert_after(list, item); \
+    mv_list_insert_before(list, item); \
   else \
     mv_list_init_singleton(list, item); \
 })
@@ -94,9 +94,9 @@
 
 /** Remove and return @a item from @a list */
 #define mv_list_pop(list, item) ({ \
-  typeof(list) __ret_elt = (item); \
-  mv_list_remove(list, item); \
-  __ret_elt; \
+  typeof(list) __pop_elt = (item); \
+  mv_list_remove(list, __pop_elt); \
+  __pop_elt; \
 })
 
 /** Remove and return the head of @a list */
@@ -64,9 +64,9 @@ void main(void) {
   nx_memalloc_init();
   mv__scheduler_init();
   beep_res = mv_semaphore_create(0);
-  mv_scheduler_create_task(beep_consumer, 512);
-  mv_scheduler_create_task(beep_producer, 512);
-  mv_scheduler_create_task(test_display, 512);
-  mv_scheduler_create_task(test_sleep, 512);
+  mv_scheduler_create_task(beep_consumer, 512, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(beep_producer, 512, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(test_display, 512, MV_QUANTUM_DEFAULT);
+  mv_scheduler_create_task(test_sleep, 512, MV_QUANTUM_DEFAULT);
   mv__scheduler_run();
 }
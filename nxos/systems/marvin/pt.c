@@ -0,0 +1,119 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/drivers/systick.h"
+
+#include "marvin/list.h"
+#include "marvin/_scheduler.h"
+
+#include "marvin/pt.h"
+
+/* The lightweight tasks run by the carrier. Only the carrier touches
+ * this list.
+ */
+static mv_pt_t *pt_active = NULL;
+
+/* Newly spawned tasks, waiting to be picked up by the carrier. Protected
+ * by the scheduler lock.
+ */
+static mv_pt_t *pt_spawned = NULL;
+
+/* The carrier waits in here when all its tasks are sleeping or done. */
+static mv__wait_queue_t carrier_waiters;
+
+/* Run every active task once. Return the time to wait before the next
+ * round: zero if some task is runnable, or MV_TIMEOUT_INFINITE if
+ * there are no tasks at all.
+ */
+static U32 carrier_round(void) {
+  U32 timeout = MV_TIMEOUT_INFINITE;
+  U32 now = nx_systick_get_ms();
+  mv_pt_t *pt, *next;
+  bool last;
+
+  pt = pt_active;
+  if (pt == NULL)
+    return timeout;
+
+  do {
+    next = pt->next;
+    last = (next == pt_active);
+
+    if (pt->sleeping && pt->wakeup_time > now) {
+      if (pt->wakeup_time - now < timeout)
+        timeout = pt->wakeup_time - now;
+    } else {
+      pt->sleeping = FALSE;
+      switch (pt->func(pt)) {
+      case MV_PT_EXITED:
+        mv_list_remove(pt_active, pt);
+        break;
+      case MV_PT_SLEEPING:
+        now = nx_systick_get_ms();
+        if (pt->wakeup_time <= now)
+          timeout = 0;
+        else if (pt->wakeup_time - now < timeout)
+          timeout = pt->wakeup_time - now;
+        break;
+      default:
+        timeout = 0;
+        break;
+      }
+    }
+
+    pt = next;
+  } while (!last && pt_active != NULL);
+
+  return timeout;
+}
+
+static void carrier(void) {
+  U32 timeout;
+  mv_pt_t *pt;
+
+  while (1) {
+    mv_scheduler_lock();
+    while ((pt = mv_list_pop_head(pt_spawned)) != NULL)
+      mv_list_add_tail(pt_active, pt);
+    mv_scheduler_unlock();
+
+    timeout = carrier_round();
+
+    /* Let the regular tasks run if some lightweight task is polling a
+     * condition, else sleep until the next wakeup or spawn.
+     */
+    if (timeout == 0) {
+      mv_scheduler_yield(FALSE);
+    } else {
+      mv_scheduler_lock();
+      if (mv_list_is_empty(pt_spawned))
+        mv__scheduler_wait(&carrier_waiters, timeout);
+      mv_scheduler_unlock();
+    }
+  }
+}
+
+void mv_pt_init(U32 stack) {
+  mv_scheduler_create_task(carrier, stack, MV_QUANTUM_DEFAULT);
+}
+
+void mv_pt_spawn(mv_pt_t *pt, mv_pt_func_t func, void *data) {
+  NX_ASSERT(func != NULL);
+
+  pt->lc = 0;
+  pt->func = func;
+  pt->data = data;
+  pt->sleeping = FALSE;
+
+  mv_scheduler_lock();
+  mv_list_add_tail(pt_spawned, pt);
+  mv__scheduler_wake_one(&carrier_waiters);
+  mv_scheduler_unlock();
+}
@@ -0,0 +1,149 @@
+/** @file pt.h
+ *  @brief Marvin's stackless lightweight tasks.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_PT_H__
+#define __NXOS_MARVIN_PT_H__
+
+#include "base/types.h"
+#include "base/drivers/systick.h"
+
+/** @defgroup pt Lightweight tasks
+ *
+ * Lightweight tasks (protothreads) are cooperative state machines that
+ * are written like regular sequential code. They have no stack of
+ * their own: all of them are run in turn by a single carrier task, and
+ * a lightweight task only costs the few bytes of its mv_pt_t.
+ *
+ * A lightweight task is a function that runs until it reaches a yield
+ * point (MV_PT_YIELD(), MV_PT_WAIT_UNTIL(), MV_PT_SLEEP()), where it
+ * returns to the carrier. The next time it is called, it resumes right
+ * after that yield point:
+ *
+ * @code
+ * static mv_pt_status_t blinker(mv_pt_t *pt) {
+ *   MV_PT_BEGIN(pt);
+ *   while (1) {
+ *     toggle_led();
+ *     MV_PT_SLEEP(pt, 500);
+ *   }
+ *   MV_PT_END(pt);
+ * }
+ * @endcode
+ *
+ * @warning Local variables are not preserved across yield points. Any
+ * state that must survive should be kept in the data pointed to by
+ * mv_pt_t::data. Also, as yield points are implemented with @c case
+ * labels, they cannot be used inside a @c switch statement of the task.
+ */
+/*@{*/
+
+/** What a lightweight task returns to its carrier. */
+typedef enum {
+  MV_PT_WAITING = 0, /**< Blocked on a condition, to be polled again. */
+  MV_PT_YIELDED, /**< Yielded the CPU, but has more work to do. */
+  MV_PT_SLEEPING, /**< Sleeping until mv_pt_t::wakeup_time. */
+  MV_PT_EXITED, /**< Done, never to be run again. */
+} mv_pt_status_t;
+
+typedef struct mv_pt mv_pt_t;
+
+/** The body of a lightweight task. */
+typedef mv_pt_status_t (*mv_pt_func_t)(mv_pt_t *pt);
+
+/** A lightweight task. */
+struct mv_pt {
+  U32 lc; /**< The local continuation, where the task resumes. */
+  mv_pt_func_t func; /**< The body of the task. */
+  void *data; /**< Task data, preserved across yield points. */
+  U32 wakeup_time; /**< When a sleeping task should resume. */
+  bool sleeping; /**< Whether the task is sleeping. */
+  struct mv_pt *prev, *next; /**< Carrier links, see list.h. */
+};
+
+/** Mark the start of the body of lightweight task @a pt. */
+#define MV_PT_BEGIN(pt) switch ((pt)->lc) { case 0:
+
+/** Mark the end of the body of lightweight task @a pt. Reaching it
+ * terminates the task.
+ */
+#define MV_PT_END(pt) } (pt)->lc = 0; return MV_PT_EXITED
+
+/** Terminate lightweight task @a pt. */
+#define MV_PT_EXIT(pt) do {                     \
+    (pt)->lc = 0;                               \
+    return MV_PT_EXITED;                        \
+  } while (0)
+
+/** Let the other lightweight tasks run before resuming @a pt. */
+#define MV_PT_YIELD(pt) do {                    \
+    (pt)->lc = __LINE__;                        \
+    return MV_PT_YIELDED;                       \
+  case __LINE__:;                               \
+  } while (0)
+
+/* A label unique to the line of a yield point. */
+#define MV_PT_LABEL2(line) mv_pt_line_##line
+#define MV_PT_LABEL(line) MV_PT_LABEL2(line)
+
+/** Block lightweight task @a pt until @a cond is true. The condition
+ * is polled every time the carrier runs the task. The jump to the
+ * check keeps compilers from warning about falling through to the case
+ * label.
+ */
+#define MV_PT_WAIT_UNTIL(pt, cond) do {         \
+    (pt)->lc = __LINE__;                        \
+    goto MV_PT_LABEL(__LINE__);                 \
+  case __LINE__:                                \
+  MV_PT_LABEL(__LINE__):                        \
+    if (!(cond))                                \
+      return MV_PT_WAITING;                     \
+  } while (0)
+
+/** Suspend lightweight task @a pt for @a ms milliseconds. Sleeping
+ * tasks are not polled, and the carrier only wakes up for them when
+ * they are due.
+ */
+#define MV_PT_SLEEP(pt, ms) do {                                \
+    (pt)->wakeup_time = nx_systick_get_ms() + (ms);             \
+    (pt)->sleeping = TRUE;                                      \
+    (pt)->lc = __LINE__;                                        \
+    return MV_PT_SLEEPING;                                      \
+  case __LINE__:;                                               \
+  } while (0)
+
+/** Start the carrier task, with @a stack bytes of stack.
+ *
+ * All the lightweight tasks run on the carrier's stack, which must be
+ * large enough for the deepest of them.
+ *
+ * @param stack The size of the carrier stack in bytes.
+ *
+ * @note As for mv_scheduler_create_task(), this can currently only be
+ * called before the scheduler starts up.
+ */
+void mv_pt_init(U32 stack);
+
+/** Start a new lightweight task running @a func.
+ *
+ * The caller provides the storage of the task, which must stay valid
+ * until the task exits. This may be called from regular tasks and from
+ * lightweight tasks.
+ *
+ * @param pt The storage for the task.
+ * @param func The body of the task.
+ * @param data The task data, available as @a pt->data.
+ */
+void mv_pt_spawn(mv_pt_t *pt, mv_pt_func_t func, void *data);
+
+/*@}*/
+
+#endif /* __NXOS_MARVIN_PT_H__ */
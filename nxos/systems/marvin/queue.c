@@ -0,0 +1,187 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/interrupts.h"
+#include "base/drivers/systick.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/list.h"
+#include "marvin/_scheduler.h"
+
+#include "marvin/queue.h"
+
+/* A ring of message buffer pointers. Rings are shared with interrupt
+ * handlers, so they are only ever touched with interrupts disabled.
+ */
+struct queue_ring {
+  void **buffers;
+  U32 head; /* The index of the oldest buffer in the ring. */
+  U32 count; /* The number of buffers in the ring. */
+};
+
+struct mv_queue {
+  U32 slots; /* The number of message buffers. */
+  U32 slot_size; /* The size of a message buffer. */
+  U8 *storage; /* The message buffers themselves. */
+
+  struct queue_ring free; /* Buffers available to producers. */
+  struct queue_ring sent; /* Buffers waiting for a consumer. */
+
+  mv__wait_queue_t producers; /* Tasks waiting for a free buffer. */
+  mv__wait_queue_t consumers; /* Tasks waiting for a message. */
+};
+
+static void ring_put(mv_queue_t *q, struct queue_ring *r, void *buffer) {
+  U32 tail;
+
+  nx_interrupts_disable();
+  tail = r->head + r->count;
+  if (tail >= q->slots)
+    tail -= q->slots;
+  r->buffers[tail] = buffer;
+  r->count++;
+  nx_interrupts_enable();
+}
+
+static void *ring_get(mv_queue_t *q, struct queue_ring *r) {
+  void *buffer = NULL;
+
+  nx_interrupts_disable();
+  if (r->count > 0) {
+    buffer = r->buffers[r->head];
+    if (++r->head == q->slots)
+      r->head = 0;
+    r->count--;
+  }
+  nx_interrupts_enable();
+
+  return buffer;
+}
+
+/* Check that @a buffer is one of the message buffers of @a q. */
+static bool queue_owns(mv_queue_t *q, void *buffer) {
+  U32 offset = (U8*)buffer - q->storage;
+
+  return ((U8*)buffer >= q->storage &&
+          offset < q->slots * q->slot_size &&
+          offset % q->slot_size == 0);
+}
+
+/* Take a buffer out of @a r, waiting on @a waiters for at most @a
+ * timeout milliseconds if it is empty.
+ */
+static void *queue_get(mv_queue_t *q, struct queue_ring *r,
+                       mv__wait_queue_t *waiters, U32 timeout) {
+  U32 deadline = nx_systick_get_ms() + timeout;
+  void *buffer;
+
+  mv_scheduler_lock();
+  while ((buffer = ring_get(q, r)) == NULL) {
+    /* Another task may have been quicker to grab the buffer we were
+     * woken up for, so the wait is resumed for the remaining time only.
+     */
+    if (timeout != MV_TIMEOUT_INFINITE) {
+      U32 now = nx_systick_get_ms();
+      timeout = (deadline > now) ? deadline - now : 0;
+    }
+
+    if (!mv__scheduler_wait(waiters, timeout))
+      break;
+  }
+  mv_scheduler_unlock();
+
+  return buffer;
+}
+
+/* Put a buffer in @a r, and wake up a task waiting for one. */
+static void queue_put(mv_queue_t *q, struct queue_ring *r,
+                      mv__wait_queue_t *waiters, void *buffer) {
+  NX_ASSERT(queue_owns(q, buffer));
+
+  mv_scheduler_lock();
+  ring_put(q, r, buffer);
+  mv__scheduler_wake_one(waiters);
+  mv_scheduler_unlock();
+}
+
+mv_queue_t *mv_queue_create(U32 slots, U32 slot_size) {
+  mv_queue_t *q;
+  U32 i;
+
+  NX_ASSERT(slots > 0 && slot_size > 0);
+
+  /* Keep all the buffers word aligned. */
+  slot_size = (slot_size + 3) & ~0x3;
+  NX_ASSERT_MSG(slot_size > 0 && slots <= (U32)-1 / slot_size,
+                "Queue too large");
+
+  q = nx_calloc(1, sizeof(*q));
+  q->slots = slots;
+  q->slot_size = slot_size;
+  q->storage = nx_malloc(slots * q->slot_size);
+
+  q->free.buffers = nx_calloc(slots, sizeof(void*));
+  q->sent.buffers = nx_calloc(slots, sizeof(void*));
+
+  for (i = 0; i < slots; i++)
+    q->free.buffers[i] = q->storage + i * q->slot_size;
+  q->free.count = slots;
+
+  mv_list_init(q->producers.waiters);
+  mv_list_init(q->consumers.waiters);
+
+  return q;
+}
+
+void *mv_queue_alloc(mv_queue_t *queue, U32 timeout) {
+  return queue_get(queue, &queue->free, &queue->producers, timeout);
+}
+
+void mv_queue_send(mv_queue_t *queue, void *buffer) {
+  queue_put(queue, &queue->sent, &queue->consumers, buffer);
+}
+
+void *mv_queue_receive(mv_queue_t *queue, U32 timeout) {
+  return queue_get(queue, &queue->sent, &queue->consumers, timeout);
+}
+
+void mv_queue_free(mv_queue_t *queue, void *buffer) {
+  queue_put(queue, &queue->free, &queue->producers, buffer);
+}
+
+void *mv_queue_isr_alloc(mv_queue_t *queue) {
+  return ring_get(queue, &queue->free);
+}
+
+void mv_queue_isr_send(mv_queue_t *queue, void *buffer) {
+  ring_put(queue, &queue->sent, buffer);
+  mv__scheduler_wake_isr(&queue->consumers);
+}
+
+void *mv_queue_isr_receive(mv_queue_t *queue) {
+  return ring_get(queue, &queue->sent);
+}
+
+void mv_queue_isr_free(mv_queue_t *queue, void *buffer) {
+  ring_put(queue, &queue->free, buffer);
+  mv__scheduler_wake_isr(&queue->producers);
+}
+
+void mv_queue_destroy(mv_queue_t *queue) {
+  mv_scheduler_lock();
+  NX_ASSERT(mv_list_is_empty(queue->producers.waiters) &&
+            mv_list_is_empty(queue->consumers.waiters));
+  NX_ASSERT(!queue->producers.post.posted && !queue->consumers.post.posted);
+  nx_free(queue->free.buffers);
+  nx_free(queue->sent.buffers);
+  nx_free(queue->storage);
+  nx_free(queue);
+  mv_scheduler_unlock();
+}
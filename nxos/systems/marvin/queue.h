@@ -0,0 +1,130 @@
+/** @file queue.h
+ *  @brief Marvin's message queue implementation.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_QUEUE_H__
+#define __NXOS_MARVIN_QUEUE_H__
+
+#include "base/types.h"
+#include "marvin/scheduler.h"
+
+typedef struct mv_queue mv_queue_t;
+
+/** Create and return a new message queue of @a slots buffers of @a
+ * slot_size bytes each.
+ *
+ * All the message buffers are allocated once, when the queue is
+ * created. Messages are then exchanged by passing the ownership of
+ * these buffers between tasks, without copying the data:
+ *
+ *  @li The producer obtains a free buffer with mv_queue_alloc(), fills
+ *      it, and hands it over to the queue with mv_queue_send().
+ *  @li The consumer obtains the oldest sent buffer with
+ *      mv_queue_receive(), processes it, and gives it back to the queue
+ *      with mv_queue_free().
+ *
+ * @param slots The number of message buffers in the queue.
+ * @param slot_size The size of a message buffer, in bytes.
+ * @return A new initialized message queue.
+ */
+mv_queue_t *mv_queue_create(U32 slots, U32 slot_size);
+
+/** Obtain a free message buffer from @a queue.
+ *
+ * The call blocks until a buffer becomes free, or @a timeout
+ * milliseconds have elapsed.
+ *
+ * @param queue The queue to take a buffer from.
+ * @param timeout The maximum time to wait, in milliseconds, or
+ * MV_TIMEOUT_INFINITE.
+ * @return A free buffer, owned by the caller, or NULL on timeout.
+ */
+void *mv_queue_alloc(mv_queue_t *queue, U32 timeout);
+
+/** Send the message in @a buffer through @a queue.
+ *
+ * This call never blocks. The caller hands the ownership of @a buffer
+ * over to the queue, and may not touch it afterwards.
+ *
+ * @param queue The queue to send the message through.
+ * @param buffer A buffer obtained from mv_queue_alloc() on @a queue.
+ */
+void mv_queue_send(mv_queue_t *queue, void *buffer);
+
+/** Receive the oldest message sent through @a queue.
+ *
+ * The call blocks until a message is available, or @a timeout
+ * milliseconds have elapsed.
+ *
+ * @param queue The queue to receive a message from.
+ * @param timeout The maximum time to wait, in milliseconds, or
+ * MV_TIMEOUT_INFINITE.
+ * @return The message buffer, owned by the caller, or NULL on timeout.
+ */
+void *mv_queue_receive(mv_queue_t *queue, U32 timeout);
+
+/** Give @a buffer back to @a queue, once its message has been processed.
+ *
+ * This call never blocks.
+ *
+ * @param queue The queue to give the buffer back to.
+ * @param buffer A buffer obtained from mv_queue_receive() on @a queue.
+ */
+void mv_queue_free(mv_queue_t *queue, void *buffer);
+
+/** @name Interrupt handler variants
+ *
+ * These functions behave like their task counterparts, but never
+ * block, and may be called from device driver interrupt handlers.
+ */
+/*@{*/
+
+/** Obtain a free message buffer from @a queue, if one is available.
+ *
+ * @param queue The queue to take a buffer from.
+ * @return A free buffer, or NULL if none is available.
+ */
+void *mv_queue_isr_alloc(mv_queue_t *queue);
+
+/** Send the message in @a buffer through @a queue.
+ *
+ * @param queue The queue to send the message through.
+ * @param buffer A buffer obtained from @a queue.
+ */
+void mv_queue_isr_send(mv_queue_t *queue, void *buffer);
+
+/** Receive the oldest message sent through @a queue, if any.
+ *
+ * @param queue The queue to receive a message from.
+ * @return The message buffer, or NULL if the queue is empty.
+ */
+void *mv_queue_isr_receive(mv_queue_t *queue);
+
+/** Give @a buffer back to @a queue.
+ *
+ * @param queue The queue to give the buffer back to.
+ * @param buffer A buffer obtained from @a queue.
+ */
+void mv_queue_isr_free(mv_queue_t *queue, void *buffer);
+
+/*@}*/
+
+/** Destroy @a queue and free any memory it uses.
+ *
+ * @param queue The queue to destroy.
+ *
+ * @warning As for semaphores, destroying a queue while tasks are
+ * blocked on it will cause Marvin to assert and crash. All the message
+ * buffers of the queue are freed as well.
+ */
+void mv_queue_destroy(mv_queue_t *queue);
+
+#endif /* __NXOS_MARVIN_QUEUE_H__ */
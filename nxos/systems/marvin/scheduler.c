@@ -9,22 +9,53 @@
 #include "base/core.h"
 #include "base/assert.h"
 #include "base/interrupts.h"
+#include "base/lock.h"
 #include "base/display.h"
+#include "base/defer.h"
+#include "base/completion.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/avr.h"
+#include "base/drivers/usb.h"
 #include "base/lib/memalloc/memalloc.h"
 #include "base/asm_decls.h"
+#include "base/util.h"
 
 #include "marvin/_task.h"
 #include "marvin/list.h"
 
 #include "marvin/_scheduler.h"
+#include "marvin/_trace.h"
 
-/* Time in milliseconds (actually in number of systick callbacks)
- * between context switches.
+/* Default time in milliseconds (actually in number of systick
+ * callbacks) between context switches.
  */
 #define TASK_EXECUTION_QUANTUM 2
 
+/* Fixed point scale of real-time task densities. The total density of
+ * all admitted EDF tasks may not exceed this value, ie. 100% of the CPU.
+ */
+#define RT_DENSITY_MAX (1 << 16)
+
+/* Stack size of the deferred work task. Deferred work functions run on
+ * this stack, and should be kept short.
+ */
+#define DEFER_TASK_STACK 512
+
+/* Pattern painted over task stacks when they are handed out, so that
+ * their high water mark can be found later.
+ */
+#define STACK_FILL 0xDEADBEEF
+
+/* Stack size classes. Task stacks are rounded up to the smallest class
+ * that fits, and recycled into a pool per class when their task dies,
+ * instead of going back to the heap. Classes go from 128 bytes to 4k in
+ * steps of 128 bytes, so that rounding wastes little memory. Larger
+ * stacks are not pooled.
+ */
+#define STACK_CLASS_STEP 128
+#define STACK_CLASSES 32
+#define STACK_CLASS_SIZE(class) (((class) + 1) * STACK_CLASS_STEP)
+
 /* An alarm calendar entry. */
 struct mv_alarm_entry {
   U32 wakeup_time;
@@ -36,11 +67,68 @@ struct mv_alarm_entry {
 struct mv_task {
   U32 *stack_base; /* The stack base (allocated pointer). */
   U32 *stack_current; /* The current position of the stack pointer. */
+  U32 stack_size; /* The size of the stack, in bytes. */
+
+  /* Scheduling class. Ready EDF tasks always run before best effort
+   * tasks, which share the remaining CPU time in a round-robin.
+   */
+  enum {
+    SCHED_BEST_EFFORT = 0,
+    SCHED_EDF,
+  } sched_class;
+
+  /* Periodic task parameters. For regular tasks, period is zero and
+   * the rest is unused.
+   */
+  nx_closure_t func; /* The job function, run once per period. */
+  U32 period; /* The release period, in milliseconds. */
+  U32 deadline; /* The relative deadline of each job, in milliseconds. */
+  U32 density; /* The declared CPU density of an EDF task. */
+  U32 release; /* The absolute release time of the current job. */
+  U32 abs_deadline; /* The absolute deadline of the current job. */
+  U32 deadline_misses; /* The number of jobs that overran their deadline. */
+
+  /* The task's alarm calendar entry, queued while the task sleeps or
+   * waits with a timeout.
+   */
+  struct mv_alarm_entry alarm;
+
+  /* Wait queue state: the task's entry in a wait queue, the queue it
+   * is currently blocked on if any, and whether its last wait timed
+   * out.
+   */
+  struct mv__waiter waiter;
+  mv__wait_queue_t *wait_queue;
+  bool wait_timed_out;
+
+  /* CPU accounting, and the time at which the task was last made ready
+   * if it has not had the CPU since.
+   */
+  mv_task_stats_t stats;
+  U32 wakeup_time;
+  bool woken;
+
+  /* Time slice, and CPU budget. A task with a budget may only run for
+   * budget milliseconds per budget period. Once it has used up its
+   * budget, it is throttled, ie. blocked until the next period.
+   */
+  U32 quantum; /* The time slice, in milliseconds. */
+  U32 budget; /* The CPU budget per period, in milliseconds, or 0. */
+  U32 budget_period; /* The budget period, in milliseconds. */
+  U32 budget_used; /* The CPU time used in the current period. */
+  U32 budget_replenish; /* The start of the next budget period. */
+
+  /* Joinable tasks keep their descriptor once dead, until another task
+   * joins them. The joining task waits on the joiners queue.
+   */
+  bool joinable;
+  mv__wait_queue_t joiners;
 
   /** Task state. */
   enum {
     READY = 0,
     BLOCKED,
+    DEAD,
   } state;
 
   /* The task structure is handled as a circularly linked list, as
@@ -51,34 +139,114 @@ struct mv_task {
 
 /* The state of the scheduler. */
 static struct {
+  struct mv_task *tasks_rt_ready; /* Ready EDF tasks, by absolute deadline. */
   struct mv_task *tasks_ready; /* All the ready tasks waiting for CPU time. */
   struct mv_task *tasks_blocked; /* Unschedulable tasks. */
 
   struct mv_task *task_current; /* The task currently consuming CPU. */
   struct mv_task *task_idle; /* The idle task. */
+  struct mv_task *task_defer; /* The deferred work task. */
 
   struct mv_alarm_entry *alarms_pending; /* A list of pending wakeup calls. */
 
   U32 last_context_switch; /* The time of the last context switch. */
-} sched_state = { NULL, NULL, NULL, NULL, NULL, 0 };
+  U32 last_accounting; /* The time up to which CPU time was charged. */
+
+  U32 rt_density; /* The total density of the admitted EDF tasks. */
+} sched_state = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, 0 };
+
+/* Scheduler statistics, see mv_scheduler_get_stats(). */
+static mv_scheduler_stats_t sched_stats;
 
 /* The scheduler lock count. This is a recursive mutex that protects
  * the data in sched_state.
  */
 static U32 sched_lock = 0;
 
+/* Wakeups posted by interrupt handlers, in an intrusive multiple
+ * producer, single consumer queue. Producers only need an atomic swap
+ * to append to the head, which the ARM7 provides. The scheduler
+ * callback consumes from the tail. The stub entry keeps the queue from
+ * ever being empty, so that producers never touch the tail.
+ */
+static struct {
+  struct mv__isr_post *volatile head; /* The last posted wakeup. */
+  struct mv__isr_post *tail; /* The oldest posted wakeup. */
+  struct mv__isr_post stub;
+} isr_posts = { &isr_posts.stub, &isr_posts.stub, { NULL, NULL, 0 } };
+
+/* The pools of recycled stacks, one per size class. Free stacks are
+ * chained through their first word.
+ */
+static U32 *stack_pool[STACK_CLASSES];
+
+/* The deferred work task sleeps in here while there is no work. */
+static mv__wait_queue_t defer_waiters;
+
+/* Tasks waiting for driver completions. There are few of them, so they
+ * share a single wait queue and check their own completion when woken
+ * up.
+ */
+static mv__wait_queue_t completion_waiters;
+
 /* Commands for tasks. These are transmitted to the scheduler from the
  * task that it preempted, and lets the task request some special operations.
  */
 static enum {
   CMD_NONE = 0,
   CMD_YIELD, /* The preempted task wants to yield to another task. */
+  CMD_PREEMPT, /* The preempted task was due for preemption while locked. */
   CMD_DIE,   /* The preempted tasks asked to be killed. */
 } task_command = CMD_NONE;
 
+/* Add @a task to the ready list of its scheduling class. EDF tasks are
+ * kept sorted by absolute deadline, after any task with the same
+ * deadline.
+ */
+static void ready_add(mv_task_t *task) {
+  mv_task_t *ptr;
+
+  if (task->sched_class == SCHED_BEST_EFFORT) {
+    mv_list_add_tail(sched_state.tasks_ready, task);
+  } else if (mv_list_is_empty(sched_state.tasks_rt_ready)) {
+    mv_list_init_singleton(sched_state.tasks_rt_ready, task);
+  } else if (task->abs_deadline < sched_state.tasks_rt_ready->abs_deadline) {
+    mv_list_add_head(sched_state.tasks_rt_ready, task);
+  } else {
+    ptr = sched_state.tasks_rt_ready;
+    while (ptr->next != sched_state.tasks_rt_ready &&
+           ptr->next->abs_deadline <= task->abs_deadline)
+      ptr = ptr->next;
+    mv_list_insert_after(ptr, task);
+  }
+}
+
+/* Remove @a task from the ready list of its scheduling class. */
+static void ready_remove(mv_task_t *task) {
+  if (task->sched_class == SCHED_BEST_EFFORT)
+    mv_list_remove(sched_state.tasks_ready, task);
+  else
+    mv_list_remove(sched_state.tasks_rt_ready, task);
+}
+
+/* Check if a ready EDF task should preempt the running task. */
+static bool rt_preempts_current(void) {
+  mv_task_t *rt = mv_list_get_head(sched_state.tasks_rt_ready);
+
+  if (rt == NULL || sched_state.task_current == NULL)
+    return FALSE;
+
+  if (sched_state.task_current->sched_class != SCHED_EDF)
+    return TRUE;
+
+  return rt->abs_deadline < sched_state.task_current->abs_deadline;
+}
+
 /* Decide on the next task to run. */
 static inline void reschedule(void) {
-  if (mv_list_is_empty(sched_state.tasks_ready)) {
+  if (!mv_list_is_empty(sched_state.tasks_rt_ready)) {
+    sched_state.task_current = mv_list_get_head(sched_state.tasks_rt_ready);
+  } else if (mv_list_is_empty(sched_state.tasks_ready)) {
     sched_state.task_current = sched_state.task_idle;
   } else {
     sched_state.task_current = mv_list_get_head(sched_state.tasks_ready);
@@ -86,11 +254,236 @@ static inline void reschedule(void) {
   }
 }
 
+/* Append @a post to the posted wakeups. Safe from any context. */
+static void isr_post_push(struct mv__isr_post *post) {
+  struct mv__isr_post *prev;
+  U32 head;
+
+  post->next = NULL;
+  head = nx_atomic_cas32((U32*)&isr_posts.head, (U32)post);
+  prev = (struct mv__isr_post*)head;
+
+  /* Until this store, the consumer sees the queue end at prev. */
+  prev->next = post;
+}
+
+/* Take the oldest posted wakeup out of the queue, or return NULL if
+ * there is none, or if the oldest one is still being appended by an
+ * interrupted producer. Must be called by the scheduler callback only.
+ */
+static struct mv__isr_post *isr_post_pop(void) {
+  struct mv__isr_post *tail = isr_posts.tail;
+  struct mv__isr_post *next = tail->next;
+
+  if (tail == &isr_posts.stub) {
+    if (next == NULL)
+      return NULL;
+    isr_posts.tail = next;
+    tail = next;
+    next = next->next;
+  }
+
+  if (next != NULL) {
+    isr_posts.tail = next;
+    return tail;
+  }
+
+  /* tail is the last entry, or a producer is between its swap and its
+   * link. In the latter case, the producer will trigger the scheduler
+   * again when it is done.
+   */
+  if (tail != isr_posts.head)
+    return NULL;
+
+  /* Put the stub back behind tail, so that tail can be taken out. */
+  isr_post_push(&isr_posts.stub);
+  next = tail->next;
+  if (next != NULL) {
+    isr_posts.tail = next;
+    return tail;
+  }
+
+  return NULL;
+}
+
+/* Check if wakeups were posted by interrupt handlers. */
+static inline bool isr_posts_pending(void) {
+  return (isr_posts.tail != &isr_posts.stub ||
+          isr_posts.stub.next != NULL);
+}
+
+/* Account for the scheduling decision that just switched from @a prev
+ * to the current task.
+ */
+static void account_switch(mv_task_t *prev, bool preempted, U32 time) {
+  mv_task_t *next = sched_state.task_current;
+  U32 latency, bucket = 0;
+
+  if (next != prev) {
+    if (prev != NULL && prev->state == READY && preempted)
+      prev->stats.preemptions++;
+    next->stats.switches++;
+    sched_stats.context_switches++;
+  }
+
+  if (next->woken) {
+    next->woken = FALSE;
+    latency = time - next->wakeup_time;
+    while (bucket < MV_LATENCY_BUCKETS - 1 && (latency >> bucket) != 0)
+      bucket++;
+    sched_stats.latency[bucket]++;
+    sched_stats.wakeups++;
+    if (latency > sched_stats.latency_max)
+      sched_stats.latency_max = latency;
+  }
+}
+
+/* Return the size class of a stack of @a size bytes, or STACK_CLASSES
+ * if it is too large to be pooled.
+ */
+static U32 stack_class(U32 size) {
+  if (size > STACK_CLASS_SIZE(STACK_CLASSES - 1))
+    return STACK_CLASSES;
+
+  return size > STACK_CLASS_STEP ? (size - 1) / STACK_CLASS_STEP : 0;
+}
+
+/* Allocate and paint a stack of at least @a *size bytes, and update @a
+ * size to the actual size of the stack.
+ */
+static U32 *stack_alloc(U32 *size) {
+  U32 class = stack_class(*size);
+  U32 *stack = NULL;
+  U32 i;
+
+  if (class < STACK_CLASSES) {
+    *size = STACK_CLASS_SIZE(class);
+
+    mv_scheduler_lock();
+    stack = stack_pool[class];
+    if (stack != NULL)
+      stack_pool[class] = (U32*)stack[0];
+    mv_scheduler_unlock();
+  }
+
+  if (stack == NULL)
+    stack = nx_malloc(*size);
+
+  for (i = 0; i < *size / sizeof(U32); i++)
+    stack[i] = STACK_FILL;
+
+  return stack;
+}
+
+/* Give @a stack of @a size bytes back to its pool, or to the heap if it
+ * is not pooled. Must be called with the scheduler locked.
+ */
+static void stack_free(U32 *stack, U32 size) {
+  U32 class = stack_class(size);
+
+  if (class < STACK_CLASSES) {
+    stack[0] = (U32)stack_pool[class];
+    stack_pool[class] = stack;
+  } else {
+    nx_free(stack);
+  }
+}
+
+/* Insert an alarm for @a task in the sorted alarm calendar. Must be
+ * called with the scheduler locked.
+ */
+static void alarm_add(mv_task_t *task, U32 wakeup_time) {
+  struct mv_alarm_entry *a = &task->alarm;
+
+  /* A task can only block on one thing at a time, hence only has one
+   * alarm.
+   */
+  NX_ASSERT(a->next == NULL);
+  a->wakeup_time = wakeup_time;
+
+  /* If the alarm list is empty, the initialization is
+   * trivial. Otherwise, we need to locate the correct place in the list
+   * for a sorted insertion.
+   */
+  if (mv_list_is_empty(sched_state.alarms_pending)) {
+    mv_list_init_singleton(sched_state.alarms_pending, a);
+  } else if (a->wakeup_time <= sched_state.alarms_pending->wakeup_time) {
+    mv_list_add_head(sched_state.alarms_pending, a);
+  } else if (a->wakeup_time >= sched_state.alarms_pending->prev->wakeup_time) {
+    mv_list_add_tail(sched_state.alarms_pending, a);
+  } else {
+    struct mv_alarm_entry *ptr = sched_state.alarms_pending;
+
+    while(ptr->next->wakeup_time < a->wakeup_time)
+      ptr = ptr->next;
+
+    mv_list_insert_after(ptr, a);
+  }
+}
+
+/* Remove the alarm of @a task from the calendar, if it is pending. Must
+ * be called with the scheduler locked.
+ */
+static void alarm_cancel(mv_task_t *task) {
+  if (task->alarm.next != NULL)
+    mv_list_remove(sched_state.alarms_pending, &task->alarm);
+}
+
+/* Charge @a elapsed milliseconds of CPU time, up to @a time, to the
+ * budget of @a task. Must be called with the scheduler locked.
+ */
+static void budget_charge(mv_task_t *task, U32 elapsed, U32 time) {
+  if (task->budget == 0)
+    return;
+
+  /* Start a new budget period if the current one is over. After a long
+   * sleep, the periods restart from now rather than catching up.
+   */
+  if (time >= task->budget_replenish) {
+    task->budget_used = 0;
+    if (time - task->budget_replenish >= task->budget_period)
+      task->budget_replenish = time + task->budget_period;
+    else
+      task->budget_replenish += task->budget_period;
+  }
+
+  task->budget_used += elapsed;
+}
+
+/* Throttle the running task if it has used up its budget. Return TRUE
+ * if it was throttled. Must be called with the scheduler locked.
+ */
+static bool budget_throttle(void) {
+  mv_task_t *t = sched_state.task_current;
+
+  if (t == NULL || t->budget == 0 || t->state != READY ||
+      t->budget_used < t->budget)
+    return FALSE;
+
+  t->stats.throttles++;
+  alarm_add(t, t->budget_replenish);
+  mv__scheduler_task_block();
+  return TRUE;
+}
+
 /* Destroy the task that was just preempted. */
 static inline void destroy_running_task(void) {
-  mv_list_remove(sched_state.tasks_ready, sched_state.task_current);
-  nx_free(sched_state.task_current->stack_base);
-  nx_free(sched_state.task_current);
+  mv__trace(MV_TRACE_EXIT, sched_state.task_current, NULL);
+  ready_remove(sched_state.task_current);
+  if (sched_state.task_current->sched_class == SCHED_EDF)
+    sched_state.rt_density -= sched_state.task_current->density;
+  stack_free(sched_state.task_current->stack_base,
+             sched_state.task_current->stack_size);
+
+  /* The descriptor of a joinable task is freed by the task joining
+   * it.
+   */
+  if (sched_state.task_current->joinable) {
+    sched_state.task_current->state = DEAD;
+    mv__scheduler_wake_all(&sched_state.task_current->joiners);
+  } else {
+    nx_free(sched_state.task_current);
+  }
   sched_state.task_current = NULL;
 }
 
@@ -100,6 +493,7 @@ static inline void destroy_running_task(void) {
 static void scheduler_cb(void) {
   U32 time = nx_systick_get_ms();
   bool need_reschedule = FALSE;
+  bool preempted = TRUE;
 
   /* Security mechanism: in case the system crashes, as long as the
    * scheduler is still running, the brick can be powered off.
@@ -113,10 +507,24 @@ static void scheduler_cb(void) {
 
   sched_lock = 1;
 
+  /* Charge the time elapsed since the last accounting to the running
+   * task. If the scheduler was locked in the meantime, the same task
+   * was running all along.
+   */
+  sched_state.task_current->stats.run_time +=
+    time - sched_state.last_accounting;
+  budget_charge(sched_state.task_current,
+                time - sched_state.last_accounting, time);
+  sched_state.last_accounting = time;
+
   /* Process pending commands, if any */
   if (task_command != CMD_NONE) {
     switch (task_command) {
     case CMD_YIELD:
+      preempted = FALSE;
+      need_reschedule = TRUE;
+      break;
+    case CMD_PREEMPT:
       need_reschedule = TRUE;
       break;
     case CMD_DIE:
@@ -130,24 +538,73 @@ static void scheduler_cb(void) {
     nx_systick_unmask_scheduler();
   } else {
     /* Check if the task quantum for the running task has expired. */
-    if (time - sched_state.last_context_switch >= TASK_EXECUTION_QUANTUM)
+    if (time - sched_state.last_context_switch >=
+        sched_state.task_current->quantum)
       need_reschedule = TRUE;
   }
 
+  /* A task that has used up its budget is set aside until its next
+   * budget period.
+   */
+  if (budget_throttle())
+    need_reschedule = TRUE;
+
   /* Wake up tasks that have scheduled alarms. */
   while (!mv_list_is_empty(sched_state.alarms_pending) &&
          sched_state.alarms_pending->wakeup_time <= time) {
     struct mv_alarm_entry *a = sched_state.alarms_pending;
-    mv_list_remove(sched_state.alarms_pending, sched_state.alarms_pending);
-    mv__scheduler_task_unblock(a->task);
-    nx_free(a);
+    mv_task_t *t = a->task;
+    mv_list_remove(sched_state.alarms_pending, a);
+    mv__trace(MV_TRACE_ALARM, t, NULL);
+
+    /* If the task was waiting with a timeout, it gives up waiting. */
+    if (t->wait_queue != NULL) {
+      mv_list_remove(t->wait_queue->waiters, &t->waiter);
+      t->wait_queue = NULL;
+      t->wait_timed_out = TRUE;
+    }
+
+    mv__scheduler_task_unblock(t);
   }
 
+  /* Carry out the wakeups posted by interrupt handlers. As several
+   * wakeups may have been merged into one post, all the waiters are
+   * woken up, and those that find nothing for them simply wait
+   * again. The post is cleared first, so that a wakeup posted while the
+   * queue is being woken up is not lost.
+   */
+  {
+    struct mv__isr_post *post;
+    while ((post = isr_post_pop()) != NULL) {
+      post->posted = 0;
+      mv__scheduler_wake_all(post->queue);
+    }
+  }
+
+  /* A newly released EDF task preempts any less urgent task. */
+  if (rt_preempts_current())
+    need_reschedule = TRUE;
+
+  /* The idle task gives way to any woken up task at once. Otherwise, it
+   * could see the woken up task neither blocked nor running, and
+   * conclude that all tasks are dead.
+   */
+  if (sched_state.task_current == sched_state.task_idle &&
+      !mv_list_is_empty(sched_state.tasks_ready))
+    need_reschedule = TRUE;
+
   /* Task switching time? */
   if (need_reschedule) {
-    if (sched_state.task_current != NULL)
-      sched_state.task_current->stack_current = mv__task_get_stack();
+    mv_task_t *prev = sched_state.task_current;
+    if (prev != NULL)
+      prev->stack_current = mv__task_get_stack();
     reschedule();
+    if (prev != sched_state.task_current) {
+      if (prev != NULL)
+        mv__trace(MV_TRACE_SWITCH_OUT, prev, NULL);
+      mv__trace(MV_TRACE_SWITCH_IN, sched_state.task_current, NULL);
+    }
+    account_switch(prev, preempted, time);
     mv__task_set_stack(sched_state.task_current->stack_current);
     sched_state.last_context_switch = nx_systick_get_ms();
   }
@@ -172,9 +629,11 @@ static mv_task_t *new_task(nx_closure_t func, U32 stack_size) {
   NX_ASSERT_MSG((stack_size & 0x3) == 0, "Stack must be\n4-byte aligned");
 
   t = nx_calloc(1, sizeof(*t));
-  t->stack_base = nx_calloc(1, stack_size);
+  t->stack_base = stack_alloc(&stack_size);
+  t->stack_size = stack_size;
   t->stack_current = (U32*) ((U32)t->stack_base + stack_size - sizeof(*s));
   s = (nx_task_stack_t*)t->stack_current;
+  memset(s, 0, sizeof(*s));
   s->pc = (U32) func;
   s->lr = (U32) task_shutdown;
   s->cpsr = MODE_SYS;
@@ -183,15 +642,26 @@ static mv_task_t *new_task(nx_closure_t func, U32 stack_size) {
     s->cpsr |= 0x20;
   }
   t->state = READY;
+  t->quantum = TASK_EXECUTION_QUANTUM;
+  t->alarm.task = t;
+  t->waiter.task = t;
 
   mv_list_init_singleton(t, t);
 
   return t;
 }
 
+/* The idle task needs more stack to walk the heap. */
+#ifdef NX_MEMALLOC_GUARDS
+#define IDLE_STACK_SIZE 256
+#else
+#define IDLE_STACK_SIZE 128
+#endif
+
 /* The idle task is where the scheduler first starts up, with interrupt
  * handling disabled. So we reenable it before getting on with out
- * Important Work: doing nothing.
+ * Important Work: doing nothing. Or, in builds with heap guards,
+ * checking the heap.
  */
 static void task_idle(void) {
   mv_scheduler_yield(FALSE);
@@ -201,24 +671,106 @@ static void task_idle(void) {
      * scheduler, but given how the scheduler is in effect implemented,
      * we're okay.
      */
-    if (mv_list_is_empty(sched_state.tasks_blocked))
+    if (mv_list_is_empty(sched_state.tasks_blocked) ||
+        (sched_state.tasks_blocked == sched_state.task_defer &&
+         sched_state.task_defer->next == sched_state.task_defer))
       NX_FAIL("All tasks dead");
+#ifdef NX_MEMALLOC_GUARDS
+    /* No task may start an allocation while the heap is walked. If one
+     * was preempted in the middle of one, the check is skipped.
+     */
+    mv_scheduler_lock();
+    nx_memalloc_check();
+    mv_scheduler_unlock();
+#endif
     mv_scheduler_yield(FALSE);
   }
 }
 
+/* The deferred work task runs the bottom halves of interrupt
+ * handlers. It sleeps until some work is queued, and then preempts any
+ * other task to run it.
+ */
+static void task_defer(void) {
+  while (1) {
+    nx_defer_run();
+
+    /* The check is done with the scheduler locked, so that a wakeup
+     * posted by an interrupt handler in between cannot be lost.
+     */
+    mv_scheduler_lock();
+    if (!nx_defer_pending())
+      mv__scheduler_wait(&defer_waiters, MV_TIMEOUT_INFINITE);
+    mv_scheduler_unlock();
+  }
+}
+
+/* Deferred work handler, called every time work is queued. */
+static void defer_notify(void) {
+  mv__scheduler_wake_isr(&defer_waiters);
+}
+
+/* Completion block handler. Drivers may also wait for completions in
+ * interrupt handlers, in deferred work, or with the scheduler locked,
+ * in which case they have to poll.
+ */
+static bool completion_can_block(void) {
+  mv_task_t *t = sched_state.task_current;
+
+  return (mv__task_in_task_mode() && sched_lock == 0 &&
+          t != sched_state.task_idle && t != sched_state.task_defer);
+}
+
+static void completion_block(nx_completion_t *c, U32 timeout) {
+  if (!completion_can_block())
+    return;
+
+  if (timeout == NX_COMPLETION_WAIT_FOREVER)
+    timeout = MV_TIMEOUT_INFINITE;
+
+  /* Checking the completion with the scheduler locked ensures that a
+   * wakeup posted in between is carried out after blocking.
+   */
+  mv_scheduler_lock();
+  if (!c->done)
+    mv__scheduler_wait(&completion_waiters, timeout);
+  mv_scheduler_unlock();
+}
+
+/* Completion notify handler, called every time a completion is
+ * signalled.
+ */
+static void completion_notify(void) {
+  mv__scheduler_wake_isr(&completion_waiters);
+}
+
 void mv__scheduler_init(void) {
-  sched_state.task_idle = new_task(task_idle, 128);
+  sched_state.task_idle = new_task(task_idle, IDLE_STACK_SIZE);
   /* The idle task doesn't start with a rolled up task state. Rewind its
    * current stack position.
    */
-  sched_state.task_idle->stack_current += sizeof(nx_task_stack_t);
+  sched_state.task_idle->stack_current =
+    (U32*) ((U32)sched_state.task_idle->stack_current +
+            sizeof(nx_task_stack_t));
   sched_state.task_current = sched_state.task_idle;
+
+  /* The deferred work task is an EDF task whose deadline is always
+   * earlier than any other, so it runs as soon as it is woken up. It
+   * is not accounted for in the admission test.
+   */
+  sched_state.task_defer = new_task(task_defer, DEFER_TASK_STACK);
+  sched_state.task_defer->sched_class = SCHED_EDF;
+  sched_state.task_defer->abs_deadline = 0;
+  ready_add(sched_state.task_defer);
 }
 
 void mv__scheduler_run(void) {
   sched_state.last_context_switch = nx_systick_get_ms();
+  sched_state.last_accounting = sched_state.last_context_switch;
   nx_interrupts_disable();
+  nx_defer_install_handler(defer_notify);
+  nx_completion_install_handlers(completion_block, completion_can_block,
+                                 completion_notify);
   nx_systick_install_scheduler(scheduler_cb);
   mv__task_run_first(task_idle, sched_state.task_idle->stack_current);
 }
@@ -226,9 +778,10 @@ void mv__scheduler_run(void) {
 void mv__scheduler_task_block(void) {
   mv_scheduler_lock();
   NX_ASSERT(sched_state.task_current->state == READY);
-  mv_list_remove(sched_state.tasks_ready, sched_state.task_current);
+  ready_remove(sched_state.task_current);
   sched_state.task_current->state = BLOCKED;
   mv_list_add_tail(sched_state.tasks_blocked, sched_state.task_current);
+  mv__trace(MV_TRACE_BLOCK, sched_state.task_current, NULL);
   mv_scheduler_unlock();
 }
 
@@ -237,52 +790,230 @@ void mv__scheduler_task_unblock(mv_task_t *task) {
   NX_ASSERT(task->state == BLOCKED);
   mv_list_remove(sched_state.tasks_blocked, task);
   task->state = READY;
-  mv_list_add_tail(sched_state.tasks_ready, task);
+  task->wakeup_time = nx_systick_get_ms();
+  task->woken = TRUE;
+  ready_add(task);
+  mv__trace(MV_TRACE_UNBLOCK, task, NULL);
+  mv_scheduler_unlock();
+}
+
+/* Block the running periodic task @a t until the release of its next
+ * job, and set the absolute deadline of that job. If the release time
+ * has already passed, return immediately.
+ */
+static void task_wait_release(mv_task_t *t) {
+  mv_scheduler_lock();
+  NX_ASSERT(t->state == READY);
+
+  t->abs_deadline = t->release + t->deadline;
+
+  if (t->release > nx_systick_get_ms()) {
+    alarm_add(t, t->release);
+    mv__scheduler_task_block();
+  } else if (t->sched_class == SCHED_EDF) {
+    /* The task stays ready, but its place in the EDF queue must follow
+     * its new deadline.
+     */
+    ready_remove(t);
+    ready_add(t);
+  }
+
+  /* If the task was configured to block, it will be preempted when the
+   * scheduler completely unlocks.
+   */
   mv_scheduler_unlock();
 }
 
+/* Body of periodic tasks. The job function is run once per period,
+ * and each job is released at an absolute multiple of the period, so
+ * that neither the job run time nor the scheduling delays accumulate
+ * into a drift.
+ */
+static void task_periodic(void) {
+  mv_task_t *t = sched_state.task_current;
+  U32 now = nx_systick_get_ms();
+
+  /* The first job is released at the first multiple of the period. */
+  t->release = now - (now % t->period);
+  if (t->release < now)
+    t->release += t->period;
+
+  while (1) {
+    task_wait_release(t);
+    t->func();
+
+    /* Check the job against its deadline. Releases that have entirely
+     * elapsed during an overrun are skipped, and count as misses as
+     * well.
+     */
+    now = nx_systick_get_ms();
+    if (now > t->abs_deadline)
+      t->deadline_misses++;
+    t->release += t->period;
+    while (t->release + t->period <= now) {
+      t->release += t->period;
+      t->deadline_misses++;
+    }
+  }
+}
+
 void mv__scheduler_task_suspend(U32 time) {
-  struct mv_alarm_entry *a;
   mv_scheduler_lock();
   NX_ASSERT(sched_state.task_current->state == READY);
 
-  /* Prepare the alarm descriptor. */
-  a = nx_calloc(1, sizeof(*a));
-  a->wakeup_time = nx_systick_get_ms() + time;
-  a->task = sched_state.task_current;
+  alarm_add(sched_state.task_current, nx_systick_get_ms() + time);
+  mv__scheduler_task_block();
+
+  /* The alarm is programmed and the task configured to block. It will
+   * be preempted when the scheduler completely unlocks.
+   */
+  mv_scheduler_unlock();
+}
+
+bool mv__scheduler_wait(mv__wait_queue_t *queue, U32 timeout) {
+  return mv__scheduler_wait_arg(queue, timeout, NULL);
+}
+
+bool mv__scheduler_wait_arg(mv__wait_queue_t *queue, U32 timeout, void *arg) {
+  mv_task_t *t = sched_state.task_current;
+
+  NX_ASSERT(sched_lock == 1);
+  NX_ASSERT(t->state == READY);
+
+  if (timeout == 0)
+    return FALSE;
 
+  t->waiter.arg = arg;
+  t->wait_queue = queue;
+  t->wait_timed_out = FALSE;
+  mv_list_add_tail(queue->waiters, &t->waiter);
+  if (timeout != MV_TIMEOUT_INFINITE)
+    alarm_add(t, nx_systick_get_ms() + timeout);
   mv__scheduler_task_block();
 
-  /* If the alarm list is empty, the initialization is
-   * trivial. Otherwise, we need to locate the correct place in the list
-   * for a sorted insertion.
+  /* Unlocking preempts the task, which resumes here once it has been
+   * woken up or its wait has timed out.
    */
-  if (mv_list_is_empty(sched_state.alarms_pending)) {
-    mv_list_init_singleton(sched_state.alarms_pending, a);
-  } else if (a->wakeup_time <= sched_state.alarms_pending->wakeup_time) {
-    mv_list_add_head(sched_state.alarms_pending, a);
-  } else if (a->wakeup_time >= sched_state.alarms_pending->prev->wakeup_time) {
-    mv_list_add_tail(sched_state.alarms_pending, a);
-  } else {
-    struct mv_alarm_entry *ptr = sched_state.alarms_pending;
+  mv_scheduler_unlock();
+  mv_scheduler_lock();
 
-    while(ptr->next->wakeup_time < a->wakeup_time)
-      ptr = ptr->next;
+  return !t->wait_timed_out;
+}
 
-    mv_list_insert_after(ptr, a);
+/* Wake up the task of @a w, which was just taken out of its wait
+ * queue. Must be called with the scheduler locked.
+ */
+static void wake_waiter(struct mv__waiter *w) {
+  w->task->wait_queue = NULL;
+  alarm_cancel(w->task);
+  mv__scheduler_task_unblock(w->task);
+}
+
+bool mv__scheduler_wake_one(mv__wait_queue_t *queue) {
+  struct mv__waiter *w = mv_list_pop_head(queue->waiters);
+
+  if (w == NULL)
+    return FALSE;
+
+  wake_waiter(w);
+  return TRUE;
+}
+
+U32 mv__scheduler_wake_all(mv__wait_queue_t *queue) {
+  struct mv__waiter *pending = queue->waiters;
+  struct mv__waiter *w;
+  U32 woken = 0;
+
+  /* Take all the waiters out, and put back those that keep waiting, so
+   * that each waiter is only looked at once.
+   */
+  mv_list_init(queue->waiters);
+  while ((w = mv_list_pop_head(pending)) != NULL) {
+    if (queue->match == NULL || queue->match(queue, w->arg)) {
+      wake_waiter(w);
+      woken++;
+    } else {
+      mv_list_add_tail(queue->waiters, w);
+    }
   }
 
-  /* The alarm is programmed and the task configured to block. It will
-   * be preempted when the scheduler completely unlocks.
+  return woken;
+}
+
+void mv__scheduler_wake_isr(mv__wait_queue_t *queue) {
+  /* Only post the queue if it is not already pending. The interrupt
+   * handler never touches the scheduler state, so it does not matter
+   * whether a task holds the scheduler lock.
    */
+  if (nx_atomic_cas8((U8*)&queue->post.posted, 1) == 0) {
+    queue->post.queue = queue;
+    isr_post_push(&queue->post);
+  }
+
+  nx_systick_call_scheduler();
+}
+
+mv_task_t *mv_scheduler_create_task(nx_closure_t func, U32 stack,
+                                    U32 quantum) {
+  mv_task_t *t = new_task(func, stack);
+  if (quantum > 0)
+    t->quantum = quantum;
+  mv_scheduler_lock();
+  ready_add(t);
+  mv_scheduler_unlock();
+  return t;
+}
+
+void mv_scheduler_set_budget(mv_task_t *task, U32 budget, U32 period) {
+  NX_ASSERT(budget == 0 || (period > 0 && budget <= period));
+  NX_ASSERT(task != sched_state.task_idle && task != sched_state.task_defer);
+
+  mv_scheduler_lock();
+  task->budget = budget;
+  task->budget_period = period;
+  task->budget_used = 0;
+  task->budget_replenish = nx_systick_get_ms() + period;
   mv_scheduler_unlock();
 }
 
-void mv_scheduler_create_task(nx_closure_t func, U32 stack) {
+mv_task_t *mv_scheduler_create_joinable_task(nx_closure_t func, U32 stack) {
   mv_task_t *t = new_task(func, stack);
+  t->joinable = TRUE;
+  mv_scheduler_lock();
+  ready_add(t);
+  mv_scheduler_unlock();
+  return t;
+}
+
+bool mv_task_join(mv_task_t *task, U32 timeout) {
+  U32 deadline = nx_systick_get_ms() + timeout;
+  bool dead;
+
+  NX_ASSERT(task->joinable);
+  NX_ASSERT(task != sched_state.task_current);
+
   mv_scheduler_lock();
-  mv_list_add_tail(sched_state.tasks_ready, t);
+  while (task->state != DEAD) {
+    if (timeout != MV_TIMEOUT_INFINITE) {
+      U32 now = nx_systick_get_ms();
+      timeout = (deadline > now) ? deadline - now : 0;
+    }
+
+    if (!mv__scheduler_wait(&task->joiners, timeout))
+      break;
+  }
+
+  dead = (task->state == DEAD);
+  if (dead)
+    nx_free(task);
   mv_scheduler_unlock();
+
+  return dead;
+}
+
+void mv_task_exit(void) {
+  NX_ASSERT(mv__task_in_task_mode() && sched_lock == 0);
+  task_shutdown();
 }
 
 void mv_scheduler_yield(bool unlock) {
@@ -293,6 +1024,69 @@ void mv_scheduler_yield(bool unlock) {
   nx_systick_call_scheduler();
 }
 
+mv_task_t *mv_scheduler_create_periodic_task(nx_closure_t func, U32 period,
+                                             U32 stack) {
+  mv_task_t *t;
+
+  NX_ASSERT(period > 0);
+
+  t = new_task(task_periodic, stack);
+  t->func = func;
+  t->period = period;
+  t->deadline = period;
+
+  mv_scheduler_lock();
+  ready_add(t);
+  mv_scheduler_unlock();
+
+  return t;
+}
+
+mv_task_t *mv_scheduler_create_rt_task(nx_closure_t func, U32 period,
+                                       U32 deadline, U32 wcet, U32 stack) {
+  mv_task_t *t;
+  U32 window, density;
+
+  NX_ASSERT(period > 0 && deadline > 0);
+  NX_ASSERT(wcet > 0 && wcet <= deadline && wcet < (1 << 16));
+
+  /* Admission test: EDF meets all deadlines as long as the sum of the
+   * task densities, wcet / min(deadline, period), does not exceed
+   * 1. Densities are rounded up, to stay on the safe side. A task whose
+   * jobs run longer than its period can never be admitted.
+   */
+  window = MIN(deadline, period);
+  if (wcet > window)
+    return NULL;
+  density = (wcet << 16) / window;
+  if ((wcet << 16) % window != 0)
+    density++;
+
+  mv_scheduler_lock();
+  if (sched_state.rt_density + density > RT_DENSITY_MAX) {
+    mv_scheduler_unlock();
+    return NULL;
+  }
+  sched_state.rt_density += density;
+
+  t = new_task(task_periodic, stack);
+  t->sched_class = SCHED_EDF;
+  t->func = func;
+  t->period = period;
+  t->deadline = deadline;
+  t->density = density;
+  t->abs_deadline = nx_systick_get_ms() + deadline;
+
+  ready_add(t);
+  mv_scheduler_unlock();
+
+  return t;
+}
+
+U32 mv_scheduler_get_deadline_misses(mv_task_t *task) {
+  return task->deadline_misses;
+}
+
 mv_task_t *mv_scheduler_get_current_task(void) {
   return sched_state.task_current;
 }
@@ -305,12 +1099,14 @@ void mv_scheduler_lock(void) {
 }
 
 void mv_scheduler_unlock(void) {
-  if (sched_lock == 1) {
+  /* There is no current task while the scheduler initializes. */
+  if (sched_lock == 1 && sched_state.task_current != NULL) {
     U32 delta = nx_systick_get_ms() - sched_state.last_context_switch;
     if (sched_state.task_current->state == BLOCKED ||
-        delta >= TASK_EXECUTION_QUANTUM) {
+        delta >= sched_state.task_current->quantum ||
+        rt_preempts_current()) {
       nx_systick_mask_scheduler();
-      task_command = CMD_YIELD;
+      task_command = CMD_PREEMPT;
       sched_lock--;
       nx_systick_call_scheduler();
       return;
@@ -319,4 +1115,138 @@ void mv_scheduler_unlock(void) {
 
   /* The scheduler did not intervene, we just unlock and keep going. */
   sched_lock--;
+
+  /* Wakeups posted by interrupt handlers while the scheduler was locked
+   * can be carried out now.
+   */
+  if (sched_lock == 0 && isr_posts_pending())
+    nx_systick_call_scheduler();
+}
+
+/* Return the task following @a task in an enumeration of all the
+ * tasks, or NULL if @a task is the last one. The enumeration starts with
+ * the idle task. Must be called with the scheduler locked.
+ */
+static mv_task_t *next_task(mv_task_t *task) {
+  mv_task_t *lists[] = {
+    sched_state.tasks_rt_ready,
+    sched_state.tasks_ready,
+    sched_state.tasks_blocked,
+  };
+  U32 i = 0;
+
+  if (task != sched_state.task_idle) {
+    if (task->state == BLOCKED)
+      i = 2;
+    else if (task->sched_class == SCHED_BEST_EFFORT)
+      i = 1;
+
+    if (task->next != lists[i])
+      return task->next;
+    i++;
+  }
+
+  for (; i < sizeof(lists) / sizeof(lists[0]); i++) {
+    if (!mv_list_is_empty(lists[i]))
+      return lists[i];
+  }
+
+  return NULL;
+}
+
+void mv_scheduler_get_stats(mv_scheduler_stats_t *stats) {
+  mv_scheduler_lock();
+  memcpy(stats, &sched_stats, sizeof(*stats));
+  mv_scheduler_unlock();
+}
+
+void mv_scheduler_get_task_stats(mv_task_t *task, mv_task_stats_t *stats) {
+  mv_scheduler_lock();
+  memcpy(stats, &task->stats, sizeof(*stats));
+  mv_scheduler_unlock();
+}
+
+void mv_scheduler_reset_stats(void) {
+  mv_task_t *t;
+
+  mv_scheduler_lock();
+  memset(&sched_stats, 0, sizeof(sched_stats));
+  for (t = sched_state.task_idle; t != NULL; t = next_task(t)) {
+    memset(&t->stats, 0, sizeof(t->stats));
+    t->woken = FALSE;
+  }
+  mv_scheduler_unlock();
+}
+
+/* The dump record of a task, see mv_scheduler_dump_stats(). */
+struct task_record {
+  U32 handle;
+  U32 kind;
+  mv_task_stats_t stats;
+};
+
+void mv_scheduler_dump_stats(void) {
+  U32 count = 0, size;
+  U8 *dump;
+  struct task_record *r;
+  mv_task_t *t;
+
+  /* Take a consistent snapshot, then send it with the scheduler
+   * unlocked.
+   */
+  mv_scheduler_lock();
+  for (t = sched_state.task_idle; t != NULL; t = next_task(t))
+    count++;
+  size = sizeof(sched_stats) + sizeof(U32) + count * sizeof(*r);
+  dump = nx_malloc(size);
+  memcpy(dump, &sched_stats, sizeof(sched_stats));
+  memcpy(dump + sizeof(sched_stats), &count, sizeof(U32));
+  r = (struct task_record*)(dump + sizeof(sched_stats) + sizeof(U32));
+  for (t = sched_state.task_idle; t != NULL; t = next_task(t), r++) {
+    r->handle = (U32)t;
+    if (t == sched_state.task_idle)
+      r->kind = 1;
+    else if (t == sched_state.task_defer)
+      r->kind = 2;
+    else
+      r->kind = 0;
+    memcpy(&r->stats, &t->stats, sizeof(t->stats));
+  }
+  mv_scheduler_unlock();
+
+  nx_usb_write((U8*)&size, sizeof(size));
+  while (!nx_usb_data_written());
+  nx_usb_write(dump, size);
+  while (!nx_usb_data_written());
+
+  nx_free(dump);
+}
+
+U32 mv_scheduler_get_stack_size(mv_task_t *task) {
+  return task->stack_size;
+}
+
+U32 mv_scheduler_get_stack_usage(mv_task_t *task) {
+  U32 i = 0;
+
+  /* Stacks grow downwards, so the untouched part is at the base. */
+  while (i < task->stack_size / sizeof(U32) &&
+         task->stack_base[i] == STACK_FILL)
+    i++;
+
+  return task->stack_size - i * sizeof(U32);
+}
+
+void mv_scheduler_flush_stack_pool(void) {
+  U32 class;
+  U32 *stack;
+
+  mv_scheduler_lock();
+  for (class = 0; class < STACK_CLASSES; class++) {
+    while ((stack = stack_pool[class]) != NULL) {
+      stack_pool[class] = (U32*)stack[0];
+      nx_free(stack);
+    }
+  }
+  mv_scheduler_unlock();
 }
@@ -17,22 +17,254 @@
 
 typedef struct mv_task mv_task_t;
 
+/** Timeout value for blocking calls that should wait indefinitely. */
+#define MV_TIMEOUT_INFINITE 0xFFFFFFFF
+
+/** CPU accounting of a single task. */
+typedef struct {
+  U32 run_time; /**< The CPU time consumed, in milliseconds. */
+  U32 switches; /**< The number of times the task was given the CPU. */
+  U32 preemptions; /**< The number of times the task lost the CPU while
+                    * still ready to run. */
+  U32 throttles; /**< The number of times the task used up its CPU
+                  * budget, see mv_scheduler_set_budget(). */
+} mv_task_stats_t;
+
+/** The number of buckets in the wakeup latency histogram. */
+#define MV_LATENCY_BUCKETS 8
+
+/** Global scheduler statistics.
+ *
+ * The wakeup latency is the time between a blocked task being made
+ * ready, and that task actually getting the CPU. Bucket 0 of the
+ * histogram counts wakeups served within the same millisecond, and
+ * bucket @e i > 0 counts latencies of 2^(@e i-1) to 2^@e i - 1
+ * milliseconds. The last bucket also counts all longer latencies.
+ */
+typedef struct {
+  U32 context_switches; /**< The total number of context switches. */
+  U32 wakeups; /**< The number of wakeups in the histogram. */
+  U32 latency_max; /**< The worst wakeup latency, in milliseconds. */
+  U32 latency[MV_LATENCY_BUCKETS]; /**< The wakeup latency histogram. */
+} mv_scheduler_stats_t;
+
+/** The default time slice of tasks, for mv_scheduler_create_task(). */
+#define MV_QUANTUM_DEFAULT 0
+
 /** Create a new task executing @a func, with @a stack bytes of stack.
  *
  * The task is placed in the ready state and enqueued for CPU time.
  *
+ * Ready tasks share the CPU in a round-robin, and each task keeps the
+ * CPU for at most @a quantum milliseconds at a time. Short quanta suit
+ * tasks that need to react quickly, long ones suit CPU-bound tasks, at
+ * the expense of the latency of the other tasks.
+ *
  * @param func The function the new task should execute.
  * @param stack The size of the task stack in bytes.
+ * @param quantum The time slice of the task in milliseconds, or
+ * MV_QUANTUM_DEFAULT for the default of 2 milliseconds.
+ * @return The handle of the new task. It is only valid until the task
+ * dies.
  *
  * @warning The stack should have sizeof(nx_task_stack_t) bytes
  * available for task switching at all times.
  *
+ * @note Stack sizes up to 4k are rounded up to a multiple of 128
+ * bytes. The stacks of dead tasks are kept for reuse by new tasks of
+ * the same size class, see mv_scheduler_flush_stack_pool().
+ *
  * @warning Currently this function can only be run before the scheduler
  * starts up.
  *
  * @note The usual size for the task stack is 1k, ie. 1024 bytes.
  */
-void mv_scheduler_create_task(nx_closure_t func, U32 stack);
+mv_task_t *mv_scheduler_create_task(nx_closure_t func, U32 stack,
+                                    U32 quantum);
+
+/** Limit the CPU time of @a task to @a budget milliseconds every @a
+ * period milliseconds.
+ *
+ * Once @a task has run for @a budget milliseconds in a period, it is
+ * throttled: it does not get the CPU again until the next period
+ * starts, even if it is ready to run. This keeps background tasks from
+ * starving the others. Periods start when the budget is set, and
+ * restart when the task first runs after having been blocked for more
+ * than a period.
+ *
+ * @param task The task to limit.
+ * @param budget The CPU time allowed per period, in milliseconds, or 0
+ * to lift the limit.
+ * @param period The budget period, in milliseconds.
+ *
+ * @note CPU time is accounted with the resolution of the system timer,
+ * so budgets are only accurate to a millisecond or so.
+ */
+void mv_scheduler_set_budget(mv_task_t *task, U32 budget, U32 period);
+
+/** Create a new joinable task executing @a func, with @a stack bytes
+ * of stack.
+ *
+ * The task runs like those created by mv_scheduler_create_task() with
+ * the default quantum, but its handle stays valid after it dies, until
+ * another task joins it with mv_task_join().
+ *
+ * @param func The function the new task should execute.
+ * @param stack The size of the task stack in bytes.
+ * @return The handle of the new task.
+ *
+ * @warning The descriptor of a joinable task that is never joined is
+ * never freed.
+ */
+mv_task_t *mv_scheduler_create_joinable_task(nx_closure_t func, U32 stack);
+
+/** Wait for the joinable @a task to finish.
+ *
+ * The call blocks until @a task returns from its function, or @a
+ * timeout milliseconds have elapsed. Once it succeeds, the handle of
+ * @a task is no longer valid. After a timeout, the join can be retried.
+ *
+ * @param task A task created by mv_scheduler_create_joinable_task().
+ * @param timeout The maximum time to wait, in milliseconds, or
+ * MV_TIMEOUT_INFINITE.
+ * @return TRUE if @a task finished, FALSE on timeout.
+ *
+ * @note Only one task may join a given task.
+ */
+bool mv_task_join(mv_task_t *task, U32 timeout);
+
+/** End the current task, as if it returned from its function.
+ *
+ * This is how periodic and real-time tasks end, from one of their
+ * jobs. The call never returns.
+ *
+ * @note The scheduler must not be locked, and interrupts must be
+ * enabled.
+ */
+void mv_task_exit(void);
+
+/** Create a new periodic task running @a func every @a period
+ * milliseconds, with @a stack bytes of stack.
+ *
+ * Unlike a task that loops over mv_time_sleep(), a periodic task is
+ * released at absolute multiples of @a period, as given by
+ * nx_systick_get_ms(). The run time of @a func and scheduling delays
+ * therefore do not make the period drift.
+ *
+ * @a func should do the work of a single period and return. If it is
+ * still running when the next release comes around, the task's
+ * deadline miss counter is incremented. The task runs until a job
+ * calls mv_task_exit().
+ *
+ * @param func The job function, called once per period.
+ * @param period The release period, in milliseconds.
+ * @param stack The size of the task stack in bytes.
+ * @return The handle of the new task.
+ *
+ * @sa mv_scheduler_create_task, mv_scheduler_get_deadline_misses
+ */
+mv_task_t *mv_scheduler_create_periodic_task(nx_closure_t func, U32 period,
+                                             U32 stack);
+
+/** Create a new real-time task running @a func every @a period
+ * milliseconds, with @a stack bytes of stack.
+ *
+ * Real-time tasks are scheduled by Earliest Deadline First (EDF): a
+ * ready real-time task always runs before best effort tasks (those
+ * created by mv_scheduler_create_task() and
+ * mv_scheduler_create_periodic_task()), and among real-time tasks the
+ * job with the earliest absolute deadline runs first.
+ *
+ * Jobs are released as for mv_scheduler_create_periodic_task(), and
+ * each job must complete within @a deadline milliseconds of its
+ * release.
+ *
+ * The task is only created if it passes the admission test: the sum
+ * of wcet / min(deadline, period) over all real-time tasks may not
+ * exceed 1. As long as the declared worst-case run times hold, every
+ * admitted task then meets all its deadlines.
+ *
+ * @param func The job function, called once per period.
+ * @param period The release period, in milliseconds.
+ * @param deadline The relative deadline of each job, in milliseconds.
+ * @param wcet The worst-case run time of a job, in milliseconds.
+ * @param stack The size of the task stack in bytes.
+ * @return The handle of the new task, or NULL if admitting it could
+ * cause deadline misses.
+ *
+ * @note Best effort tasks only get the CPU time left over by the
+ * real-time tasks.
+ */
+mv_task_t *mv_scheduler_create_rt_task(nx_closure_t func, U32 period,
+                                       U32 deadline, U32 wcet, U32 stack);
+
+/** Return the number of deadlines missed by the periodic @a task.
+ *
+ * A deadline is missed every time a job of the task is still running
+ * after its deadline. For tasks created with
+ * mv_scheduler_create_periodic_task(), the deadline is the next job's
+ * release.
+ *
+ * @param task The periodic task to query.
+ * @return The number of deadlines missed since the task was created.
+ */
+U32 mv_scheduler_get_deadline_misses(mv_task_t *task);
+
+/** Copy the global scheduler statistics into @a stats.
+ *
+ * @param stats The structure to fill.
+ */
+void mv_scheduler_get_stats(mv_scheduler_stats_t *stats);
+
+/** Copy the CPU accounting of @a task into @a stats.
+ *
+ * Run time is accounted with the resolution of the system timer: each
+ * millisecond is charged to the task running when it ends.
+ *
+ * @param task The task to query.
+ * @param stats The structure to fill.
+ */
+void mv_scheduler_get_task_stats(mv_task_t *task, mv_task_stats_t *stats);
+
+/** Reset the global statistics and the accounting of all tasks. */
+void mv_scheduler_reset_stats(void);
+
+/** Send the global statistics and the accounting of all tasks to the
+ * USB host.
+ *
+ * The dump follows the protocol of usb_console/read_usb_dump.py, and
+ * can be decoded with its @c sched mode. All values are little endian
+ * U32s: the fields of mv_scheduler_stats_t, then the number of tasks,
+ * then for each task its handle, its kind (0 for regular tasks, 1 for
+ * the idle task and 2 for the deferred work task), and the fields of
+ * mv_task_stats_t.
+ *
+ * @note This call blocks until the whole dump has been sent.
+ */
+void mv_scheduler_dump_stats(void);
+
+/** Return the size of the stack of @a task.
+ *
+ * @param task The task to query.
+ * @return The stack size in bytes, after rounding to its size class.
+ */
+U32 mv_scheduler_get_stack_size(mv_task_t *task);
+
+/** Return the high water mark of the stack of @a task.
+ *
+ * Stacks are painted with a fill pattern when their task is created,
+ * and the high water mark is the extent of the overwritten part.
+ *
+ * @param task The task to query.
+ * @return The maximum number of stack bytes used by @a task so far.
+ *
+ * @note If the returned value is the full stack size, the task has
+ * most probably overflowed its stack.
+ */
+U32 mv_scheduler_get_stack_usage(mv_task_t *task);
+
+/** Give the stacks kept for reuse back to the heap. */
+void mv_scheduler_flush_stack_pool(void);
 
 /** Explicitely yield the CPU.
  *
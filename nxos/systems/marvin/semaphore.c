@@ -13,27 +13,15 @@
 
 #include "marvin/list.h"
 #include "marvin/_scheduler.h"
+#include "marvin/_trace.h"
 
 #include "marvin/semaphore.h"
 
-struct sem_task_handle {
-  mv_task_t *task;
-  struct sem_task_handle *prev, *next;
-};
-
 struct mv_sem {
-  S32 count; /* The number of available resources if >= 0, or the number
-              * of tasks blocking on the semaphore if < 0.
-              */
-  struct sem_task_handle *blocked_tasks;
+  S32 count; /* The number of available resources. */
+  mv__wait_queue_t waiters; /* Tasks waiting for a resource. */
 };
 
-static struct sem_task_handle *make_sem_task_handle(mv_task_t *task) {
-  struct sem_task_handle *h = nx_calloc(1, sizeof(*h));
-  h->task = task;
-  return h;
-}
-
 mv_sem_t *mv_semaphore_create(S32 count) {
   mv_sem_t *sem;
 
@@ -41,28 +29,36 @@ mv_sem_t *mv_semaphore_create(S32 count) {
 
   sem = nx_calloc(1, sizeof(*sem));
   sem->count = count;
-  mv_list_init(sem->blocked_tasks);
+  mv_list_init(sem->waiters.waiters);
 
   return sem;
 }
 
 void mv_semaphore_dec(mv_sem_t *sem) {
+  mv_semaphore_dec_timeout(sem, MV_TIMEOUT_INFINITE);
+}
+
+bool mv_semaphore_dec_timeout(mv_sem_t *sem, U32 timeout) {
+  bool success = FALSE;
+
   mv_scheduler_lock();
-  sem->count--;
 
-  /* If we're beyond what the semaphore can handle, this task needs to
-   * block. It will get resumed when/if the semaphore gets incremented.
+  /* If no resource is available, this task needs to block. Waiters are
+   * served in their order of arrival: mv_semaphore_inc() hands the
+   * resource directly to the first one, without making it available to
+   * other tasks, and marks it as granted.
    */
-  if (sem->count < 0) {
-    mv_task_t *current = mv_scheduler_get_current_task();
-    struct sem_task_handle *h = make_sem_task_handle(current);
-
-    /* Mark the task as blocked and enqueue it in the semaphore info. */
-    mv__scheduler_task_block();
-    mv_list_add_tail(sem->blocked_tasks, h);
+  if (sem->count > 0) {
+    sem->count--;
+    success = TRUE;
+  } else {
+    mv__scheduler_wait_arg(&sem->waiters, timeout, &success);
   }
 
+  mv__trace(success ? MV_TRACE_SEM_DEC : MV_TRACE_SEM_TIMEOUT,
+            mv_scheduler_get_current_task(), sem);
   mv_scheduler_unlock();
+  return success;
 }
 
 bool mv_semaphore_try_dec(mv_sem_t *sem) {
@@ -71,22 +67,27 @@ bool mv_semaphore_try_dec(mv_sem_t *sem) {
   if (sem->count > 0) {
     sem->count--;
     success = TRUE;
+    mv__trace(MV_TRACE_SEM_DEC, mv_scheduler_get_current_task(), sem);
   }
   mv_scheduler_unlock();
   return success;
 }
 
 void mv_semaphore_inc(mv_sem_t *sem) {
+  struct mv__waiter *w;
+
   mv_scheduler_lock();
-  sem->count++;
+  mv__trace(MV_TRACE_SEM_INC, mv_scheduler_get_current_task(), sem);
 
-  /* If we are/were beyond what the semaphore can handle, we need to
-   * wake up one of the blocked tasks.
+  /* Hand the resource over to the first blocked task, if any, or make
+   * it available.
    */
-  if (sem->count <= 0) {
-    struct sem_task_handle *h = mv_list_pop_head(sem->blocked_tasks);
-    mv__scheduler_task_unblock(h->task);
-    nx_free(h);
+  w = mv_list_get_head(sem->waiters.waiters);
+  if (w != NULL) {
+    *(bool*)w->arg = TRUE;
+    mv__scheduler_wake_one(&sem->waiters);
+  } else {
+    sem->count++;
   }
 
   mv_scheduler_unlock();
@@ -94,7 +95,7 @@ void mv_semaphore_inc(mv_sem_t *sem) {
 
 void mv_semaphore_destroy(mv_sem_t *sem) {
   mv_scheduler_lock();
-  NX_ASSERT(sem->count >= 0);
+  NX_ASSERT(mv_list_is_empty(sem->waiters.waiters));
   nx_free(sem);
   mv_scheduler_unlock();
 }
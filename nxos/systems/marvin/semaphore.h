@@ -14,6 +14,7 @@
 #define __NXOS_MARVIN_SEMAPHORE_H__
 
 #include "base/types.h"
+#include "marvin/scheduler.h"
 
 typedef struct mv_sem mv_sem_t;
 
@@ -46,6 +47,20 @@ mv_sem_t *mv_semaphore_create(S32 count);
  */
 void mv_semaphore_dec(mv_sem_t *sem);
 
+/** Acquire one resource of @a sem, waiting at most @a timeout
+ * milliseconds.
+ *
+ * The function call will block the task until a resource becomes
+ * available, or the timeout expires.
+ *
+ * @param sem The semaphore to decrement.
+ * @param timeout The maximum time to wait, in milliseconds, or
+ * MV_TIMEOUT_INFINITE.
+ * @return TRUE if the resource was successfully acquired, FALSE on
+ * timeout.
+ */
+bool mv_semaphore_dec_timeout(mv_sem_t *sem, U32 timeout);
+
 /** Attempt to acquire one resource of @a sem.
  *
  * The function call will not block. The return value indicates whether
@@ -19,7 +19,9 @@
  *
  * @note This API is roughly equivalent to the baseplate's
  * nx_systick_wait_ms(), except that this function is scheduler-aware,
- * and therefore does not busy-wait the CPU.
+ * and therefore does not busy-wait the CPU. Once Marvin runs,
+ * nx_systick_wait_ms() also blocks tasks, but the sleeping task is
+ * woken up by every driver completion.
  */
 void mv_time_sleep(U32 ms);
 
@@ -0,0 +1,112 @@
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#include "base/types.h"
+#include "base/assert.h"
+#include "base/util.h"
+#include "base/drivers/systick.h"
+#include "base/drivers/usb.h"
+#include "base/lib/memalloc/memalloc.h"
+
+#include "marvin/scheduler.h"
+
+#include "marvin/_trace.h"
+
+/* The trace ring. All the writers hold the scheduler lock, so no
+ * further locking is needed.
+ */
+static struct {
+  mv_trace_event_t *events;
+  U32 size; /* The number of events in the ring. */
+  U32 head; /* The index of the next event to write. */
+  U32 recorded; /* The number of events recorded since the start. */
+  bool enabled;
+} trace;
+
+void mv__trace(mv_trace_event_type_t type, mv_task_t *task, void *object) {
+  mv_trace_event_t *e;
+
+  if (!trace.enabled)
+    return;
+
+  e = &trace.events[trace.head];
+  e->time = nx_systick_get_ms();
+  e->task = (U32)task;
+  e->object = (U16)(U32)object;
+  e->type = type;
+  e->reserved = 0;
+
+  if (++trace.head == trace.size)
+    trace.head = 0;
+  trace.recorded++;
+}
+
+void mv_trace_start(U32 events) {
+  NX_ASSERT(events > 0);
+
+  mv_trace_free();
+
+  mv_scheduler_lock();
+  trace.events = nx_malloc(events * sizeof(mv_trace_event_t));
+  trace.size = events;
+  trace.head = 0;
+  trace.recorded = 0;
+  trace.enabled = TRUE;
+  mv_scheduler_unlock();
+}
+
+void mv_trace_stop(void) {
+  mv_scheduler_lock();
+  trace.enabled = FALSE;
+  mv_scheduler_unlock();
+}
+
+void mv_trace_dump(void) {
+  U32 count, first, i, size;
+  U32 *dump;
+  mv_trace_event_t *e;
+
+  /* Take a consistent snapshot, then send it with the scheduler
+   * unlocked.
+   */
+  mv_scheduler_lock();
+  count = MIN(trace.recorded, trace.size);
+  size = 2 * sizeof(U32) + count * sizeof(mv_trace_event_t);
+  dump = nx_malloc(size);
+  dump[0] = count;
+  dump[1] = trace.recorded - count;
+  e = (mv_trace_event_t*)(dump + 2);
+
+  /* Once the ring has wrapped around, the oldest event is the next one
+   * to be overwritten.
+   */
+  first = (count == trace.size) ? trace.head : 0;
+  for (i = 0; i < count; i++) {
+    memcpy(&e[i], &trace.events[first], sizeof(*e));
+    if (++first == trace.size)
+      first = 0;
+  }
+  mv_scheduler_unlock();
+
+  nx_usb_write((U8*)&size, sizeof(size));
+  while (!nx_usb_data_written());
+  nx_usb_write((U8*)dump, size);
+  while (!nx_usb_data_written());
+
+  nx_free(dump);
+}
+
+void mv_trace_free(void) {
+  mv_scheduler_lock();
+  trace.enabled = FALSE;
+  if (trace.events)
+    nx_free(trace.events);
+  trace.events = NULL;
+  trace.size = trace.head = trace.recorded = 0;
+  mv_scheduler_unlock();
+}
@@ -0,0 +1,72 @@
+/** @file trace.h
+ *  @brief Marvin's scheduler event tracing.
+ */
+
+/* Copyright (c) 2009 the NxOS developers
+ *
+ * See AUTHORS for a full list of the developers.
+ *
+ * Redistribution of this file is permitted under
+ * the terms of the GNU Public License (GPL) version 2.
+ */
+
+#ifndef __NXOS_MARVIN_TRACE_H__
+#define __NXOS_MARVIN_TRACE_H__
+
+#include "base/types.h"
+
+/** Types of the traced scheduler events. */
+typedef enum {
+  MV_TRACE_SWITCH_IN = 0, /**< The task gets the CPU. */
+  MV_TRACE_SWITCH_OUT, /**< The task loses the CPU. */
+  MV_TRACE_BLOCK, /**< The task blocks. */
+  MV_TRACE_UNBLOCK, /**< The task is made ready again. */
+  MV_TRACE_ALARM, /**< The alarm of the task fires. */
+  MV_TRACE_SEM_DEC, /**< The task acquires a semaphore. */
+  MV_TRACE_SEM_TIMEOUT, /**< The task gives up acquiring a semaphore. */
+  MV_TRACE_SEM_INC, /**< The task releases a semaphore. */
+  MV_TRACE_EXIT, /**< The task dies. */
+} mv_trace_event_type_t;
+
+/** A traced event, as stored in the trace buffer and dumped. */
+typedef struct {
+  U32 time; /**< The time of the event, in milliseconds. */
+  U32 task; /**< The handle of the task concerned. */
+  U16 object; /**< The low half of the address of the semaphore for
+               * semaphore events, 0 otherwise. */
+  U8 type; /**< The event type, see mv_trace_event_type_t. */
+  U8 reserved;
+} mv_trace_event_t;
+
+/** Start tracing scheduler events into a buffer of @a events entries.
+ *
+ * Once the buffer is full, the oldest events are overwritten. Any
+ * previous trace is discarded.
+ *
+ * @param events The number of events to keep.
+ *
+ * @note The buffer takes sizeof(mv_trace_event_t) bytes per event from
+ * the heap, until mv_trace_free() is called.
+ */
+void mv_trace_start(U32 events);
+
+/** Stop tracing, keeping the recorded events for mv_trace_dump(). */
+void mv_trace_stop(void);
+
+/** Send the recorded events to the USB host.
+ *
+ * The dump follows the protocol of usb_console/read_usb_dump.py, and
+ * can be decoded with its @c trace mode. It contains the number of
+ * events in the dump and the number of events lost because the buffer
+ * was full, as little endian U32s, followed by the events from the
+ * oldest to the newest, laid out as mv_trace_event_t.
+ *
+ * @note This call blocks until the whole dump has been sent. Tracing
+ * goes on meanwhile, unless it was stopped.
+ */
+void mv_trace_dump(void);
+
+/** Stop tracing, and free the trace buffer. */
+void mv_trace_free(void);
+
+#endif /* __NXOS_MARVIN_TRACE_H__ */
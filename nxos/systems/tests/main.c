@@ -7,6 +7,7 @@
  */
 
 #include "base/core.h"
+#include "base/timer.h"
 #include "base/drivers/systick.h"
 #include "base/drivers/avr.h"
 #include "base/drivers/radar.h"
@@ -30,7 +31,9 @@
  * system timer and AVR link are working, pressing the Cancel button
  * should power off the brick.
  */
-static void security_hook(void) {
+static nx_timer_t security_timer;
+
+static void security_hook(nx_timer_t *timer __attribute__((unused))) {
   if (nx_avr_get_button() == BUTTON_CANCEL)
     nx_core_halt();
 }
@@ -65,7 +68,8 @@ static void display_rotation_data (S8 vel, S32 tot, S8 sangle) {
 }
 
 void main(void) {
-  nx_systick_install_scheduler(security_hook);
+  nx_timer_init(&security_timer);
+  nx_timer_start(&security_timer, 10, security_hook, TRUE);
 
   bool moving = FALSE;
   S32 total_rotation = 0;
@@ -371,6 +371,65 @@ void tests_sysinfo(void) {
 
 
 
+void tests_systick(void) {
+  U32 i, start, end, last, now;
+  hello();
+
+  nx_display_clear();
+  nx_display_cursor_set_pos(0,0);
+  nx_display_string("- Systick test -\n"
+		    "----------------\n");
+
+  /* The microsecond clock must never go backwards, even across the
+   * ticks held up while interrupts are disabled. Several ticks are held
+   * up, so that the system time has to catch up with all of them.
+   */
+  start = nx_systick_get_ms();
+  last = nx_systick_get_us();
+  for (i=0; i<100000; i++) {
+    if (i == 1000) {
+      nx_interrupts_disable();
+      nx_systick_wait_us(5000);
+    } else if (i == 2000) {
+      nx_interrupts_enable();
+    }
+    now = nx_systick_get_us();
+    NX_ASSERT(now - last < 1000000);
+    last = now;
+  }
+  NX_ASSERT(nx_systick_get_ms() - start >= 5);
+  NX_ASSERT(nx_systick_get_us() / 1000 - nx_systick_get_ms() <= 1);
+
+  nx_display_string("wait_us(10): ");
+  start = nx_systick_get_us();
+  nx_systick_wait_us(10);
+  end = nx_systick_get_us();
+  NX_ASSERT(end - start >= 10);
+  nx_display_uint(end - start);
+  nx_display_end_line();
+
+  nx_display_string("wait_us(1k): ");
+  nx_interrupts_disable();
+  start = nx_systick_get_us();
+  nx_systick_wait_us(1000);
+  end = nx_systick_get_us();
+  nx_interrupts_enable();
+  NX_ASSERT(end - start >= 1000);
+  nx_display_uint(end - start);
+  nx_display_end_line();
+
+  nx_display_string("wait_ns(10k): ");
+  start = nx_systick_get_us();
+  nx_systick_wait_ns(10000);
+  end = nx_systick_get_us();
+  nx_display_uint(end - start);
+  nx_display_end_line();
+
+  nx_systick_wait_ms(5000);
+  goodbye();
+}
+
+
 static void tests_bt_list_known_devices(void) {
   bt_device_t dev;
 
@@ -532,6 +591,8 @@ static int tests_command(char *buffer) {
     tests_display();
   else if (streq(buffer, "sysinfo"))
     tests_sysinfo();
+  else if (streq(buffer, "systick"))
+    tests_systick();
   else if (streq(buffer, "sensors"))
     tests_sensors();
   else if (streq(buffer, "tachy"))
@@ -883,6 +944,7 @@ void tests_all(void) {
   tests_tachy();
   tests_sensors();
   tests_sysinfo();
+  tests_systick();
   tests_radar();
   tests_fs();
 
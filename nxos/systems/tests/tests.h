@@ -17,6 +17,7 @@ void tests_motor(void);
 void tests_sound(void);
 void tests_display(void);
 void tests_sysinfo(void);
+void tests_systick(void);
 void tests_sensors(void);
 void tests_tachy(void);
 void tests_usb(void);
@@ -0,0 +1,52 @@
+#!/usr/bin/env python
+
+# NxOS heap dump beautifier, for the dumps sent by nx_memalloc_dump().
+#
+# The allocating code is only known for baseplates built with
+# memalloc_tags=1. Its addresses can be resolved with
+# arm-elf-addr2line -e <kernel>.elf.
+
+import struct
+
+FL_CLASSES = 24
+STATS_FIELDS = ("pool_size", "used", "peak_used", "free", "largest_free",
+                "free_blocks", "allocs", "frees", "fl_bitmap")
+
+def beautify(data, size):
+    raw = "".join([ chr(i) for i in data[:size] ])
+    words = struct.unpack("<%dL" % (size / 4), raw)
+
+    stats = dict(zip(STATS_FIELDS, words[:len(STATS_FIELDS)]))
+    sl_bitmap = words[len(STATS_FIELDS):len(STATS_FIELDS)+FL_CLASSES]
+    count = words[len(STATS_FIELDS)+FL_CLASSES]
+    blocks = words[len(STATS_FIELDS)+FL_CLASSES+1:]
+
+    print "Pool: %(pool_size)d bytes, %(used)d used, %(peak_used)d peak" % stats
+    print "Free: %(free)d bytes in %(free_blocks)d blocks, " \
+        "largest %(largest_free)d" % stats
+    if stats["free"]:
+        print "Fragmentation: %.1f%%" % (
+            100.0 * (1 - float(stats["largest_free"]) / stats["free"]))
+    print "Blocks: %(allocs)d allocated, %(frees)d freed" % stats
+
+    print
+    print "Free lists:"
+    for fl in xrange(FL_CLASSES):
+        if stats["fl_bitmap"] & (1 << fl):
+            low = fl and 1 << (fl + 6) or 0
+            print "  %6d+ bytes  0x%08x" % (low, sl_bitmap[fl])
+
+    callers = {}
+    print
+    print "%d allocated blocks:" % count
+    for i in xrange(count):
+        address, length, caller = blocks[3*i:3*i+3]
+        print "  0x%08x %8d  from 0x%08x" % (address, length, caller)
+        n, total = callers.get(caller, (0, 0))
+        callers[caller] = (n + 1, total + length)
+
+    print
+    print "By allocating code:"
+    for caller, (n, total) in sorted(callers.items(),
+                                     key=lambda c: -c[1][1]):
+        print "  0x%08x %6d blocks %8d bytes" % (caller, n, total)
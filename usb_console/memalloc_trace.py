@@ -0,0 +1,28 @@
+#!/usr/bin/env python
+
+# Saver for the allocation traces recorded by an nx_memalloc_set_trace_hook()
+# hook, to be replayed by the host harness in nxos/base/lib/memalloc/host.
+#
+# Through read_usb_dump.py:
+#   read_usb_dump.py memtrace out.trace
+
+import struct
+
+OPS = ("alloc", "realloc", "free", "move")
+RECORD_SIZE = 16
+
+def beautify(data, size, args=[]):
+    raw = "".join([ chr(i) for i in data[:size - size % RECORD_SIZE] ])
+
+    counts = [ 0 ] * len(OPS)
+    for i in xrange(0, len(raw), RECORD_SIZE):
+        op = struct.unpack("<L", raw[i:i+4])[0]
+        if op < len(OPS):
+            counts[op] += 1
+    print ", ".join([ "%d %ss" % (c, o) for o, c in zip(OPS, counts) ])
+
+    if args:
+        f = open(args[0], "wb")
+        f.write(raw)
+        f.close()
+        print "Wrote %d records to %s" % (len(raw) / RECORD_SIZE, args[0])
@@ -51,6 +51,18 @@ def main():
       elif sys.argv[1] == 'ascii':
         from ascii_dump import beautify
         beautify(data, size)
+      elif sys.argv[1] == 'sched':
+        from sched_stats import beautify
+        beautify(data, size)
+      elif sys.argv[1] == 'trace':
+        from sched_trace import beautify
+        beautify(data, size, sys.argv[2:])
+      elif sys.argv[1] == 'heap':
+        from heap_dump import beautify
+        beautify(data, size)
+      elif sys.argv[1] == 'memtrace':
+        from memalloc_trace import beautify
+        beautify(data, size, sys.argv[2:])
       else:
         print [ str(i) for i in data ]
 
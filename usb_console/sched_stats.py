@@ -0,0 +1,41 @@
+#!/usr/bin/env python
+
+# Marvin scheduler statistics beautifier, for the dumps sent by
+# mv_scheduler_dump_stats().
+
+import struct
+
+LATENCY_BUCKETS = 8
+TASK_KINDS = { 0: "task", 1: "idle", 2: "defer" }
+
+def beautify(data, size):
+    raw = "".join([ chr(i) for i in data[:size] ])
+    words = struct.unpack("<%dL" % (size / 4), raw)
+
+    switches, wakeups, latency_max = words[0:3]
+    latency = words[3:3+LATENCY_BUCKETS]
+    count = words[3+LATENCY_BUCKETS]
+    tasks = words[4+LATENCY_BUCKETS:]
+
+    print "Context switches: %d" % switches
+    print "Wakeups: %d, worst latency: %d ms" % (wakeups, latency_max)
+    for i in xrange(LATENCY_BUCKETS):
+        if i == 0:
+            label = "0 ms"
+        elif i == LATENCY_BUCKETS - 1:
+            label = ">= %d ms" % (1 << (i-1))
+        else:
+            label = "%d-%d ms" % (1 << (i-1), (1 << i) - 1)
+        print "  %-10s %d" % (label, latency[i])
+
+    print
+    print "%-10s %-6s %10s %10s %12s %10s" % ("Task", "Kind", "Run (ms)",
+                                              "Switches", "Preemptions",
+                                              "Throttles")
+    for i in xrange(count):
+        handle, kind, run_time, switches, preemptions, throttles = \
+            tasks[6*i:6*i+6]
+        print "0x%08x %-6s %10d %10d %12d %10d" % (handle,
+                                                    TASK_KINDS.get(kind, "?"),
+                                                    run_time, switches,
+                                                    preemptions, throttles)
@@ -0,0 +1,164 @@
+#!/usr/bin/env python
+
+# Marvin scheduler trace viewer, for the dumps sent by mv_trace_dump().
+#
+# Through read_usb_dump.py:
+#   read_usb_dump.py trace               per-task timeline as text
+#   read_usb_dump.py trace out.json      Chrome trace (chrome://tracing)
+#
+# On a dump saved to a file (the data following the size word):
+#   sched_trace.py dump.bin [out.json]
+
+import struct
+import sys
+
+# Event types, see mv_trace_event_type_t in systems/marvin/trace.h.
+SWITCH_IN, SWITCH_OUT, BLOCK, UNBLOCK, ALARM, \
+    SEM_DEC, SEM_TIMEOUT, SEM_INC, EXIT = range(9)
+
+INSTANT_NAMES = { ALARM: "alarm", SEM_DEC: "sem dec",
+                  SEM_TIMEOUT: "sem timeout", SEM_INC: "sem inc" }
+
+EVENT_FORMAT = "<LLHBB"
+EVENT_SIZE = struct.calcsize(EVENT_FORMAT)
+
+def parse(raw):
+    count, lost = struct.unpack("<LL", raw[:8])
+    events = []
+    for i in xrange(count):
+        offset = 8 + i * EVENT_SIZE
+        time, task, obj, type, _ = struct.unpack(
+            EVENT_FORMAT, raw[offset:offset+EVENT_SIZE])
+        events.append((time, task, obj, type))
+    return events, lost
+
+class Task:
+    def __init__(self, handle):
+        self.handle = handle
+        self.state = None       # running, ready, blocked, or unknown
+        self.since = None       # Start time of the current state.
+        self.blocking = False   # Blocked, but still running.
+        self.woken = None       # Time of the last unblock.
+        self.intervals = []     # (state, start, end)
+        self.instants = []      # (name, time, object)
+        self.run_time = 0
+        self.runs = 0
+        self.latency_max = 0
+
+    def enter(self, state, time):
+        if self.state is not None and self.since is not None:
+            self.intervals.append((self.state, self.since, time))
+            if self.state == "running":
+                self.run_time += time - self.since
+        self.state = state
+        self.since = time
+
+def build_timeline(events):
+    tasks = {}
+    order = []
+
+    for time, handle, obj, type in events:
+        if handle not in tasks:
+            tasks[handle] = Task(handle)
+            order.append(handle)
+        t = tasks[handle]
+
+        if type == SWITCH_IN:
+            if t.woken is not None:
+                t.latency_max = max(t.latency_max, time - t.woken)
+                t.woken = None
+            t.runs += 1
+            t.enter("running", time)
+        elif type == SWITCH_OUT:
+            if t.blocking:
+                t.blocking = False
+                t.enter("blocked", time)
+            else:
+                t.enter("ready", time)
+        elif type == BLOCK:
+            t.blocking = True
+        elif type == UNBLOCK:
+            t.blocking = False
+            t.woken = time
+            if t.state != "running":
+                t.enter("ready", time)
+        elif type == EXIT:
+            t.enter(None, time)
+        elif type in INSTANT_NAMES:
+            t.instants.append((INSTANT_NAMES[type], time, obj))
+
+    # Close the states still open at the end of the trace.
+    if events:
+        end = events[-1][0]
+        for t in tasks.values():
+            if t.state is not None:
+                t.enter(t.state, end)
+
+    return [ tasks[h] for h in order ]
+
+def print_text(tasks, events, lost):
+    if events:
+        print "%d events from %d ms to %d ms, %d older events lost" % (
+            len(events), events[0][0], events[-1][0], lost)
+    else:
+        print "No events, %d lost" % lost
+
+    for t in tasks:
+        print
+        print "Task 0x%08x: ran %d ms in %d runs, worst wakeup latency %d ms" \
+            % (t.handle, t.run_time, t.runs, t.latency_max)
+
+        lines = [ (start, "%6d - %6d ms  %s" % (start, end, state))
+                  for state, start, end in t.intervals if end > start ]
+        lines += [ (time, "%6d ms           %s%s" % (
+                    time, name, obj and " 0x%04x" % obj or ""))
+                   for name, time, obj in t.instants ]
+        lines.sort(key=lambda l: l[0])
+        for _, line in lines:
+            print "  " + line
+
+def chrome_json(tasks):
+    import json
+
+    trace = []
+    for tid, t in enumerate(tasks):
+        trace.append({ "name": "thread_name", "ph": "M", "pid": 1,
+                       "tid": tid,
+                       "args": { "name": "task 0x%08x" % t.handle } })
+        for state, start, end in t.intervals:
+            if end > start:
+                trace.append({ "name": state, "ph": "X", "pid": 1,
+                               "tid": tid, "ts": start * 1000,
+                               "dur": (end - start) * 1000 })
+        for name, time, obj in t.instants:
+            trace.append({ "name": name, "ph": "i", "s": "t", "pid": 1,
+                           "tid": tid, "ts": time * 1000,
+                           "args": { "object": "0x%04x" % obj } })
+
+    return json.dumps({ "traceEvents": trace, "displayTimeUnit": "ms" })
+
+def beautify(data, size, args=[]):
+    raw = "".join([ chr(i) for i in data[:size] ])
+    events, lost = parse(raw)
+    tasks = build_timeline(events)
+
+    if args:
+        f = open(args[0], "w")
+        f.write(chrome_json(tasks))
+        f.close()
+        print "Wrote %d events of %d tasks to %s" % (len(events), len(tasks),
+                                                     args[0])
+    else:
+        print_text(tasks, events, lost)
+
+def main():
+    if len(sys.argv) < 2:
+        print "Usage: %s <dump file> [chrome trace file]" % sys.argv[0]
+        return False
+
+    raw = open(sys.argv[1], "rb").read()
+    beautify([ ord(c) for c in raw ], len(raw), sys.argv[2:])
+    return True
+
+if __name__ == "__main__":
+    main()